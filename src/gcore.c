@@ -17,14 +17,31 @@
 #include <gcore_defs.h>
 #include <stdint.h>
 #include <elf.h>
+#include <getopt.h>
+#include <regex.h>
 
 static void gcore_offset_table_init(void);
 static void gcore_size_table_init(void);
 static void gcore_machdep_init(void);
 
-static void do_gcore(char *arg);
+static int do_gcore(char *arg, struct task_context *tc);
+static void do_gcore_all(ulong min_rss, char *comm);
 static void print_version(void);
 
+enum {
+	GCORE_OPT_MIN_RSS = 256,
+	GCORE_OPT_COMM,
+	GCORE_OPT_FAULTS,
+};
+
+static struct option gcore_long_options[] = {
+	{ "all", no_argument, NULL, 'a' },
+	{ "min-rss", required_argument, NULL, GCORE_OPT_MIN_RSS },
+	{ "comm", required_argument, NULL, GCORE_OPT_COMM },
+	{ "faults", required_argument, NULL, GCORE_OPT_FAULTS },
+	{ NULL, 0, NULL, 0 }
+};
+
 static struct command_table_entry command_table[] = {
 	{ "gcore", cmd_gcore, help_gcore, 0 },
 	{ (char *)NULL }                               
@@ -39,6 +56,7 @@ _init(void) /* Register the command set. */
 	gcore_arch_table_init();
 	gcore_arch_regsets_init();
 	gcore_machdep_init();
+	gcore_objcache_table_init();
         register_extension(command_table);
 	return 1;
 }
@@ -53,18 +71,34 @@ char *help_gcore[] = {
 "gcore",
 "gcore - retrieve a process image as a core dump",
 "\n"
-"  gcore [-v vlevel] [-f filter] [pid | taskp]*\n"
+"  gcore [-v vlevel] [-f filter] [-j threads] [-o options] [--faults mode]\n"
+"        [pid | taskp]*\n"
+"  gcore [-v vlevel] [-f filter] [-j threads] [-o options] [--faults mode]\n"
+"        -a|--all [--min-rss size] [--comm regex]\n"
 "  This command retrieves a process image as a core dump.",
 "  ",
 "    -v Display verbose information according to vlevel:",
 "  ",
-"           progress  library error  page fault",
-"       ---------------------------------------",
+"           progress  library error  page fault  stats  stats JSON",
+"       ---------------------------------------------------------",
 "         0",
 "         1    x",
 "         2                  x",
 "         4                                x    (default)",
+"         8                                          x",
+"        16                                                  x",
 "         7    x             x             x",
+"        31    x             x             x         x      x",
+"  ",
+"       stats prints the wall and CPU time of each phase and the pages",
+"       and bytes of each core as a table, and stats JSON as one JSON line",
+"       per core; both count the readmem() and uvtop() calls made to copy",
+"       memory, walk page tables and maple trees and read kernel objects.",
+"  ",
+"       Pages that makedumpfile excluded from a kdump-compressed dump file",
+"       are left as holes without being read, and are counted by progress,",
+"       which also tells how many bytes of each memory area to dump can be",
+"       recovered from the dump file.",
 "  ",
 "    -f Specify kinds of memory to be written into core dumps according to",
 "       the filter flag in bitwise:",
@@ -91,6 +125,88 @@ char *help_gcore[] = {
 "        HS  Hugetlb Shared Memory",
 "        DD  Memory advised using madvise with MADV_DONTDUMP flag",
 " ",
+"    -j Copy memory with the given number of threads. Each thread reads the",
+"       dump file and writes the core file by itself, which requires an ELF",
+"       or a kdump-compressed dump file, whose pages the threads decompress",
+"       if it is compressed with zlib, lzo or zstd; otherwise memory is",
+"       copied serially. The threads also read the task_struct, cred, saved",
+"       user registers and FPU state of every thread ahead of note",
+"       collection.",
+"  ",
+"    -o Specify how core dumps are written, as a comma-separated list of:",
+"  ",
+"         bufsize=SIZE  size of the output buffer; a multiple of the page",
+"                       size, optionally suffixed with K, M or G (1M by",
+"                       default)",
+"         direct        write page-aligned data with O_DIRECT, bypassing the",
+"                       page cache",
+"         uring[=N]     keep up to N (4 by default) buffer writes in flight",
+"                       with io_uring",
+"         compress=CODEC[:LEVEL]",
+"                       compress with zstd, lz4 or gzip, appending .zst,",
+"                       .lz4 or .gz to the file name. Each buffer becomes",
+"                       an independent frame, and zstd and lz4 files end",
+"                       with a seek table in the zstd seekable format. The",
+"                       -j threads compress zstd frames instead of copying",
+"                       memory. direct and uring are not used.",
+"         stream[=PATH] write the core strictly sequentially, so that it",
+"                       can go to a pipe, a FIFO or a character device;",
+"                       to PATH instead of core.<pid> if given. Holes",
+"                       are written as zeros, -j threads do not copy",
+"                       memory, and direct and uring are not used. A",
+"                       PATH that is not a regular file is always",
+"                       streamed. PATH takes a single process, so it",
+"                       cannot be given with -a or several pids.",
+"         dedup         copy pages that an earlier core of the same command",
+"                       already holds, such as shared libraries and pages",
+"                       shared by forked processes, from that core instead",
+"                       of reading them from the dump file again. On",
+"                       filesystems supporting reflinks, the cores share",
+"                       these blocks. Not used with compress or stream.",
+"         trim[=GAP]    scan the page tables first, and leave page-faulted",
+"                       pages at the end of each memory area out of the",
+"                       core; also split an area around page-faulted gaps",
+"                       of GAP bytes (1M by default) or more, so that they",
+"                       take no room either. Such pages are then missing",
+"                       from the core instead of reading as zeros.",
+"         resume        record the progress of the copy in core.<pid>.journal",
+"                       and, if gcore fails or is interrupted, continue",
+"                       from there when run again with resume on the same",
+"                       process, provided the headers and notes written",
+"                       are the same. The journal is removed once the",
+"                       core is saved. Not used with compress, stream or",
+"                       tolerant.",
+"         tolerant      leave pages that cannot be read from the dump file,",
+"                       such as pages missing from a filtered or truncated",
+"                       dump, as holes instead of failing, and list their",
+"                       address ranges in a note named GCORE, of type 1,",
+"                       at the end of the core. Compressed and streamed",
+"                       cores have no such note; the ranges are printed",
+"                       with -v 1.",
+"  ",
+"    -a, --all",
+"       Retrieve every user process in the dump, largest resident set first.",
+"       A process that fails is reported and the others are still dumped;",
+"       a summary is printed at the end.",
+"  ",
+"    --min-rss size",
+"       With -a, skip processes whose resident set is smaller than size,",
+"       optionally suffixed with K, M or G.",
+"  ",
+"    --comm regex",
+"       With -a, only retrieve processes whose command name matches the",
+"       extended regular expression regex.",
+"  ",
+"    --faults mode",
+"       Specify how page faults met while copying memory are reported at",
+"       vlevel 4, as one of:",
+"  ",
+"         ranges[:N]    one line per range of contiguous page-faulted",
+"                       pages, at most N (64 by default) per core, then a",
+"                       summary (default)",
+"         summary       only the summary of page-faulted pages and ranges",
+"         pages         one line per page-faulted page",
+"  ",
 "    -V Display version information",
 "  ",
 "  If no pid or taskp is specified, gcore tries to retrieve the process image",
@@ -138,6 +254,25 @@ char *help_gcore[] = {
 "    Saved core.30102",
 "    crash>",
 "  ",
+"  A core can be sent elsewhere without a local copy, through a FIFO read by",
+"  ssh or nc.",
+"  ",
+"    $ mkfifo /tmp/core.fifo",
+"    $ ssh host 'cat > core.12345' < /tmp/core.fifo &",
+"    crash> gcore -o stream=/tmp/core.fifo 12345",
+"    Saved /tmp/core.fifo",
+"  ",
+"  Retrieve all the processes using at least 64MB of memory at once.",
+"  ",
+"    crash> gcore -j 8 --all --min-rss 64M",
+"    [1/3] PID 4242 java, 10485760 kB",
+"    Saved core.4242.java",
+"    [2/3] PID 1201 mysqld, 2097152 kB",
+"    Saved core.1201.mysqld",
+"    [3/3] PID 977 systemd-journal, 73728 kB",
+"    Saved core.977.systemd-journal",
+"    3 of 3 processes saved (12656640 kB resident) in 95 seconds",
+"  ",
 "  If no argument is given, gcore tries to retrieve the process of the current",
 "  task context.",
 "  ",
@@ -160,8 +295,10 @@ char *help_gcore[] = {
 "  ",
 "    crash> gcore -v 1 1234 -v 1",
 "    Usage: gcore",
-"      gcore [-v vlevel] [-f filter] [pid | taskp]*",
-"      gcore -d",
+"      gcore [-v vlevel] [-f filter] [-j threads] [-o options] [--faults mode]",
+"            [pid | taskp]*",
+"      gcore [-v vlevel] [-f filter] [-j threads] [-o options] [--faults mode]",
+"            -a|--all [--min-rss size] [--comm regex]",
 "    Enter \"help gcore\" for details.",
 "  ",
 "  It is allowed to specify -v and -f options in a different order.",
@@ -181,23 +318,45 @@ NULL,
 void
 cmd_gcore(void)
 {
-	char *foptarg, *voptarg;
-	int c, optversion;
+	char *foptarg, *voptarg, *joptarg, *ooptarg, *roptarg, *coptarg;
+	char *faultsoptarg;
+	int c, optversion, optall;
 
 	if (ACTIVE())
 		error(FATAL, "no support on live kernel\n");
 
 	gcore_dumpfilter_set_default();
 	gcore_verbose_set_default();
+	gcore_parallel_set_default();
+	gcore_writer_set_default();
+	gcore_dedup_set_default();
+	gcore_thread_group_reset();
 
-	foptarg = voptarg = NULL;
-	optversion = FALSE;
+	foptarg = voptarg = joptarg = ooptarg = roptarg = coptarg = NULL;
+	faultsoptarg = NULL;
+	optversion = optall = FALSE;
 
-	while ((c = getopt(argcnt, args, "f:v:V")) != EOF) {
+	while ((c = getopt_long(argcnt, args, "f:v:j:o:Va", gcore_long_options,
+				NULL)) != EOF) {
 		switch (c) {
 		case 'V':
 			optversion = TRUE;
 			break;
+		case 'a':
+			if (optall)
+				goto argerr;
+			optall = TRUE;
+			break;
+		case GCORE_OPT_MIN_RSS:
+			if (roptarg)
+				goto argerr;
+			roptarg = optarg;
+			break;
+		case GCORE_OPT_COMM:
+			if (coptarg)
+				goto argerr;
+			coptarg = optarg;
+			break;
 		case 'f':
 			if (foptarg)
 				goto argerr;
@@ -208,6 +367,21 @@ cmd_gcore(void)
 				goto argerr;
 			voptarg = optarg;
 			break;
+		case 'j':
+			if (joptarg)
+				goto argerr;
+			joptarg = optarg;
+			break;
+		case 'o':
+			if (ooptarg)
+				goto argerr;
+			ooptarg = optarg;
+			break;
+		case GCORE_OPT_FAULTS:
+			if (faultsoptarg)
+				goto argerr;
+			faultsoptarg = optarg;
+			break;
 		default:
 		argerr:
 			argerrs++;
@@ -215,6 +389,12 @@ cmd_gcore(void)
 		}
 	}
 
+	if ((roptarg || coptarg) && !optall)
+		argerrs++;
+
+	if (optall && args[optind])
+		argerrs++;
+
 	if (argerrs) {
 		cmd_usage(pc->curcmd, SYNOPSIS);
 	}
@@ -249,27 +429,201 @@ cmd_gcore(void)
 
 	}
 
-	if (!args[optind]) {
-		do_gcore(NULL);
-		return;
+	if (joptarg) {
+		ulong value;
+
+		if (!decimal(joptarg, 0))
+			error(FATAL, "threads must be a decimal: %s.\n",
+			      joptarg);
+
+		value = stol(joptarg, gcore_verbose_error_handle(), NULL);
+		if (!gcore_parallel_set(value))
+			error(FATAL, "invalid number of threads: %s.\n",
+			      joptarg);
+	}
+
+	if (ooptarg) {
+		if (!gcore_writer_set(ooptarg))
+			error(FATAL, "invalid output options: %s.\n",
+			      ooptarg);
+		if (gcore_writer_stream_path() &&
+		    (optall || (args[optind] && args[optind + 1])))
+			error(FATAL, "stream=PATH cannot hold the cores of "
+			      "several processes.\n");
+	}
+
+	if (faultsoptarg) {
+		if (!gcore_verbose_set_faults(faultsoptarg))
+			error(FATAL, "invalid page fault mode: %s.\n",
+			      faultsoptarg);
+	}
+
+	if (optall) {
+		ulong min_rss = 0;
+
+		if (roptarg && !gcore_writer_parse_size(roptarg, &min_rss))
+			error(FATAL, "invalid size: %s.\n", roptarg);
+
+		do_gcore_all(min_rss / PAGESIZE(), coptarg);
+	} else if (!args[optind]) {
+		do_gcore(NULL, NULL);
+	} else {
+		for (; args[optind]; optind++) {
+			do_gcore(args[optind], NULL);
+			free_all_bufs();
+		}
+	}
+
+	/* State kept across the tasks of this command. */
+	gcore_dedup_set_default();
+	gcore_thread_group_reset();
+
+}
+
+struct gcore_all_entry
+{
+	struct task_context *tc;
+	ulong rss;		/* in pages */
+};
+
+/*
+ * Processes dumped between two scans of the task table by do_gcore_all().
+ */
+#define GCORE_ALL_BATCH 64
+
+static int gcore_all_compare(const void *a, const void *b)
+{
+	const struct gcore_all_entry *x = a, *y = b;
+
+	if (x->rss != y->rss)
+		return x->rss < y->rss ? 1 : -1;
+
+	return x->tc->pid < y->tc->pid ? -1 : x->tc->pid > y->tc->pid;
+}
+
+/*
+ * Collect the thread group leaders to dump that sort after @after, or
+ * all of them if it is NULL, and copy the first @max of them in order
+ * into @batch. Return how many there are in all.
+ *
+ * The list is GETBUF()ed, so that it is reclaimed even if reading the
+ * task table fails.
+ */
+static ulong gcore_all_collect(ulong min_rss, regex_t *re,
+			       struct gcore_all_entry *after,
+			       struct gcore_all_entry *batch, ulong max)
+{
+	struct gcore_all_entry *list;
+	struct task_context *tc;
+	ulong i, n;
+
+	list = (struct gcore_all_entry *)
+		GETBUF(RUNNING_TASKS() * sizeof(*list));
+
+	n = 0;
+	tc = FIRST_CONTEXT();
+	for (i = 0; i < RUNNING_TASKS(); i++, tc++) {
+		struct task_mem_usage tm;
+
+		if (!tc->mm_struct || is_kernel_thread(tc->task) ||
+		    gcore_task_tgid(tc) != tc->pid)
+			continue;
+		if (re && regexec(re, tc->comm, 0, NULL, 0))
+			continue;
+
+		get_task_mem_usage(tc->task, &tm);
+		if (tm.rss < min_rss)
+			continue;
+
+		list[n].tc = tc;
+		list[n].rss = tm.rss;
+		if (after && gcore_all_compare(&list[n], after) <= 0)
+			continue;
+		n++;
 	}
 
-	for (; args[optind]; optind++) {
-		do_gcore(args[optind]);
-		free_all_bufs();
+	qsort(list, n, sizeof(*list), gcore_all_compare);
+	memcpy(batch, list, MIN(n, max) * sizeof(*list));
+
+	FREEBUF(list);
+
+	return n;
+}
+
+/**
+ * do_gcore_all - do process core dump for every user process
+ *
+ * @min_rss smallest resident set, in pages, of a process to dump
+ * @comm    extended regular expression a command name has to match,
+ *          or NULL
+ *
+ * Thread group leaders are collected from the task table and dumped
+ * largest resident set first, so that the biggest cores, the ones most
+ * at risk of running out of disk space, are written first. As buffers
+ * are all freed after each process, the order is kept GCORE_ALL_BATCH
+ * processes at a time, and the task table scanned again for the next
+ * ones; the dump file does not change, and neither does the order.
+ *
+ * Processes are dumped one at a time, as crash's context and readmem()
+ * are not thread-safe; the -j threads copy memory within each one.
+ * A failure in one process is caught by do_gcore() and counted, and
+ * the others are still dumped.
+ */
+static void do_gcore_all(ulong min_rss, char *comm)
+{
+	struct gcore_all_entry batch[GCORE_ALL_BATCH], last = { NULL, 0 };
+	ulong i, j, n, total, saved, rss;
+	time_t start;
+	regex_t re;
+
+	if (comm && regcomp(&re, comm, REG_EXTENDED|REG_NOSUB))
+		error(FATAL, "invalid regular expression: %s\n", comm);
+
+	start = time(NULL);
+	total = saved = rss = 0;
+
+	for (i = 0; ; ) {
+		n = gcore_all_collect(min_rss, comm ? &re : NULL,
+				      i ? &last : NULL, batch,
+				      GCORE_ALL_BATCH);
+		if (!i)
+			total = n;
+		if (!n)
+			break;
+
+		for (j = 0; j < MIN(n, GCORE_ALL_BATCH); j++, i++) {
+			fprintf(fp, "[%lu/%lu] PID %lu %s, %lu kB\n", i + 1,
+				total, batch[j].tc->pid, batch[j].tc->comm,
+				batch[j].rss * (PAGESIZE() / 1024));
+			if (do_gcore(NULL, batch[j].tc)) {
+				saved++;
+				rss += batch[j].rss;
+			}
+			free_all_bufs();
+		}
+		last = batch[j - 1];
 	}
 
+	if (comm)
+		regfree(&re);
+
+	fprintf(fp, "%lu of %lu processes saved (%lu kB resident) in %ld "
+		"seconds\n", saved, total, rss * (PAGESIZE() / 1024),
+		(long)(time(NULL) - start));
 }
 
 /**
  * do_gcore - do process core dump for a given task
  *
  * @arg string that refers to PID or task context's address
+ * @tc  task context to dump instead of @arg, or NULL
  *
  * Given the string, arg, refering to PID or task context's address,
  * do_gcore tries to do process coredump for the corresponding
- * task. If the string given is NULL, do_gcore does the process dump
- * for the current task context.
+ * task. If neither the string nor the task context is given, do_gcore
+ * does the process dump for the current task context.
+ *
+ * Return TRUE if the core dump has been saved; otherwise FALSE.
  *
  * Here is the unique exception point in gcore sub-command. Any fatal
  * action during gcore sub-command will come back here. Look carefully
@@ -280,25 +634,24 @@ cmd_gcore(void)
  * operation. Thus, it is necessary to call free_all_bufs() each time
  * calling do_gcore(). See the end of cmd_gcore().
  */
-static void do_gcore(char *arg)
+static int do_gcore(char *arg, struct task_context *tc)
 {
 	if (!setjmp(pc->foreach_loop_env)) {
-		struct task_context *tc;
 		ulong dummy;
 
 		BZERO(gcore, sizeof(struct gcore_one_session_data));
 
 		pc->flags |= IN_FOREACH;
 
-		if (arg) {
+		if (!tc && arg) {
 			if (!IS_A_NUMBER(arg))
 				error(FATAL, "neither pid nor taskp: %s\n",
-				      args[optind]);
+				      arg);
 
 			if (STR_INVALID == str_to_context(arg, &dummy, &tc))
 				error(FATAL, "invalid task or pid: %s\n",
-				      args[optind]);
-		} else
+				      arg);
+		} else if (!tc)
 			tc = CURRENT_CONTEXT();
 
 		if (is_kernel_thread(tc->task))
@@ -309,8 +662,12 @@ static void do_gcore(char *arg)
 			(void) set_context(tc->task, NO_PID);
 		}
 
-		snprintf(gcore->corename, CORENAME_MAX_SIZE + 1, "core.%lu.%s",
-			 task_tgid(CURRENT_TASK()), CURRENT_COMM());
+		snprintf(gcore->corename, CORENAME_MAX_SIZE + 1, "core.%lu.%s%s",
+			 task_tgid(CURRENT_TASK()), CURRENT_COMM(),
+			 gcore_writer_suffix());
+		if (gcore_writer_stream_path())
+			snprintf(gcore->corename, CORENAME_MAX_SIZE + 1, "%s",
+				 gcore_writer_stream_path());
 
 		gcore_elf_init(gcore);
 
@@ -319,19 +676,21 @@ static void do_gcore(char *arg)
 
 	pc->flags &= ~IN_FOREACH;
 
-	if (gcore->fp != NULL) {
-		if (fflush(gcore->fp) == EOF) {
-			error(FATAL, "%s: flush %s\n", gcore->corename,
-			      strerror(errno));
-		}
-		if (fclose(gcore->fp) == EOF) {
-			gcore->fp = NULL;
+	/* Stop copy threads left running by a failure. */
+	gcore_parallel_finish();
+
+	if (gcore->writer != NULL) {
+		struct gcore_writer *writer = gcore->writer;
+
+		gcore->writer = NULL;
+		if (!gcore_writer_close(writer))
 			error(FATAL, "%s: close %s\n", gcore->corename,
 			      strerror(errno));
-		}
-		gcore->fp = NULL;
 	}
 
+	gcore_dedup_end(gcore->flags & GCF_SUCCESS);
+	gcore_journal_close(gcore->flags & GCF_SUCCESS);
+
 	if (gcore->flags & GCF_UNDER_COREDUMP) {
 		if (gcore->flags & GCF_SUCCESS)
 			fprintf(fp, "Saved %s\n", gcore->corename);
@@ -342,6 +701,7 @@ static void do_gcore(char *arg)
 	if (gcore->orig_task)
 		(void)set_context(gcore->orig_task, NO_PID);
 
+	return (gcore->flags & GCF_SUCCESS) ? TRUE : FALSE;
 }
 
 static void print_version(void)
@@ -374,6 +734,10 @@ static void gcore_offset_table_init(void)
 	GCORE_MEMBER_OFFSET_INIT(mm_struct_saved_auxv, "mm_struct", "saved_auxv");
 	GCORE_MEMBER_OFFSET_INIT(mm_struct_saved_files, "mm_struct", "saved_files");
 	GCORE_MEMBER_OFFSET_INIT(mm_struct_context, "mm_struct", "context");
+	GCORE_MEMBER_OFFSET_INIT(mm_struct_mm_mt, "mm_struct", "mm_mt");
+	GCORE_MEMBER_OFFSET_INIT(maple_tree_ma_root, "maple_tree", "ma_root");
+	GCORE_MEMBER_OFFSET_INIT(maple_range_64_pivot, "maple_range_64", "pivot");
+	GCORE_MEMBER_OFFSET_INIT(maple_arange_64_pivot, "maple_arange_64", "pivot");
 	GCORE_MEMBER_OFFSET_INIT(pid_level, "pid", "level");
 	GCORE_MEMBER_OFFSET_INIT(pid_namespace_level, "pid_namespace", "level");
         if (MEMBER_EXISTS("pt_regs", "ax"))
@@ -520,6 +884,9 @@ static void gcore_size_table_init(void)
 {
 	GCORE_STRUCT_SIZE_INIT(i387_union, "i387_union");
 	GCORE_STRUCT_SIZE_INIT(mm_context_t, "mm_context_t");
+	GCORE_STRUCT_SIZE_INIT(maple_node, "maple_node");
+	GCORE_MEMBER_SIZE_INIT(maple_range_64_pivot, "maple_range_64", "pivot");
+	GCORE_MEMBER_SIZE_INIT(maple_arange_64_pivot, "maple_arange_64", "pivot");
 	GCORE_MEMBER_SIZE_INIT(mm_struct_saved_auxv, "mm_struct", "saved_auxv");
 	GCORE_MEMBER_SIZE_INIT(mm_struct_saved_files, "mm_struct", "saved_files");
 	GCORE_MEMBER_SIZE_INIT(thread_struct_ds, "thread_struct", "ds");
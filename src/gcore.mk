@@ -60,6 +60,30 @@ ifeq ($(shell arch), ppc64le)
   ARCH=SUPPORTED
 endif
 
+ifeq ($(shell /bin/ls /usr/include/linux/io_uring.h 2>/dev/null), /usr/include/linux/io_uring.h)
+  FEATURE_CFLAGS+=-DGCORE_HAVE_IO_URING
+endif
+
+ifeq ($(shell /bin/ls /usr/include/zstd.h 2>/dev/null), /usr/include/zstd.h)
+  FEATURE_CFLAGS+=-DGCORE_HAVE_ZSTD
+  FEATURE_LIBS+=-lzstd
+endif
+
+ifeq ($(shell /bin/ls /usr/include/lz4frame.h 2>/dev/null), /usr/include/lz4frame.h)
+  FEATURE_CFLAGS+=-DGCORE_HAVE_LZ4
+  FEATURE_LIBS+=-llz4
+endif
+
+ifeq ($(shell /bin/ls /usr/include/zlib.h 2>/dev/null), /usr/include/zlib.h)
+  FEATURE_CFLAGS+=-DGCORE_HAVE_ZLIB
+  FEATURE_LIBS+=-lz
+endif
+
+ifeq ($(shell /bin/ls /usr/include/lzo/lzo1x.h 2>/dev/null), /usr/include/lzo/lzo1x.h)
+  FEATURE_CFLAGS+=-DGCORE_HAVE_LZO
+  FEATURE_LIBS+=-llzo2
+endif
+
 ifeq ($(shell /bin/ls /usr/include/crash/defs.h 2>/dev/null), /usr/include/crash/defs.h)
   INCDIR=/usr/include/crash
 endif
@@ -71,13 +95,23 @@ ifeq ($(shell /bin/ls ../defs.h 2> /dev/null), ../defs.h)
 endif
 
 GCORE_CFILES = \
+	libgcore/gcore_bitmap.c \
+	libgcore/gcore_compress.c \
+	libgcore/gcore_copy.c \
+	libgcore/gcore_copy_parallel.c \
 	libgcore/gcore_coredump.c \
 	libgcore/gcore_coredump_table.c \
+	libgcore/gcore_dedup.c \
 	libgcore/gcore_dumpfilter.c \
 	libgcore/gcore_elf_struct.c \
 	libgcore/gcore_global_data.c \
+	libgcore/gcore_journal.c \
+	libgcore/gcore_maple.c \
+	libgcore/gcore_objcache.c \
 	libgcore/gcore_regset.c \
-	libgcore/gcore_verbose.c
+	libgcore/gcore_uring.c \
+	libgcore/gcore_verbose.c \
+	libgcore/gcore_writer.c
 
 ifneq (,$(findstring $(TARGET), X86 X86_64))
 GCORE_CFILES += libgcore/gcore_x86.c
@@ -103,7 +137,7 @@ GCORE_OFILES = $(patsubst %.c,%.o,$(GCORE_CFILES))
 
 COMMON_CFLAGS=-Wall -I$(INCDIR) -I./libgcore -fPIC -D$(TARGET) \
 	-DVERSION='"$(VERSION)"' -DRELEASE_DATE='"$(DATE)"' \
-	-DPERIOD='"$(PERIOD)"'
+	-DPERIOD='"$(PERIOD)"' -pthread $(FEATURE_CFLAGS)
 
 all: gcore.so
 
@@ -112,7 +146,7 @@ gcore.so: gcore.c $(INCDIR)/defs.h
 		echo "gcore: architecture not supported"; \
 	else \
 		make -f gcore.mk $(GCORE_OFILES) && \
-		gcc $(RPM_OPT_FLAGS) $(CFLAGS) $(TARGET_CFLAGS) $(COMMON_CFLAGS) $(ARCH_CFLAGS) -nostartfiles -shared -rdynamic $(GCORE_OFILES) -Wl,-soname,$@ -o $@ $< ; \
+		gcc $(RPM_OPT_FLAGS) $(CFLAGS) $(TARGET_CFLAGS) $(COMMON_CFLAGS) $(ARCH_CFLAGS) -nostartfiles -shared -rdynamic $(GCORE_OFILES) $(FEATURE_LIBS) -Wl,-soname,$@ -o $@ $< ; \
 	fi;
 
 %.o: %.c $(INCDIR)/defs.h
@@ -29,8 +29,8 @@ static int gpr_get(struct task_context *target,
 
 	BZERO(regs, sizeof(*regs));
 
-	readmem(machdep->get_stacktop(target->task) - 8 - SIZE(pt_regs), KVADDR,
-		regs, SIZE(pt_regs), "genregs_get: pt_regs",
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, regs, SIZE(pt_regs), "genregs_get: pt_regs",
 		gcore_verbose_error_handle());
 
 	return 0;
@@ -154,4 +154,9 @@ int gcore_arch_vsyscall_has_vm_alwaysdump_flag(void)
 	return FALSE;
 }
 
+ulong gcore_arch_user_regs(struct task_context *tc)
+{
+	return machdep->get_stacktop(tc->task) - 8 - SIZE(pt_regs);
+}
+
 #endif /* defined(ARM) */
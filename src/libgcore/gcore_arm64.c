@@ -28,9 +28,8 @@ static int gpr_get(struct task_context *target,
 
 	BZERO(regs, sizeof(*regs));
 
-	readmem(machdep->get_stacktop(target->task) -
-		machdep->machspec->user_eframe_offset - SIZE(pt_regs), KVADDR,
-		regs, sizeof(struct user_pt_regs), "gpr_get: user_pt_regs",
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, regs, sizeof(struct user_pt_regs), "gpr_get: user_pt_regs",
 		gcore_verbose_error_handle());
 
 	return 0;
@@ -125,9 +124,8 @@ static int compat_gpr_get(struct task_context *target,
 	BZERO(&pt_regs, sizeof(pt_regs));
 	BZERO(regs, sizeof(*regs));
 
-	readmem(machdep->get_stacktop(target->task) -
-		machdep->machspec->user_eframe_offset - SIZE(pt_regs), KVADDR,
-		&pt_regs, sizeof(struct pt_regs), "compat_gpr_get: pt_regs",
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, &pt_regs, sizeof(struct pt_regs), "compat_gpr_get: pt_regs",
 		gcore_verbose_error_handle());
 
 	regs->r0 = pt_regs.user_regs.regs[0];
@@ -249,4 +247,10 @@ int gcore_arch_vsyscall_has_vm_alwaysdump_flag(void)
 	return FALSE;
 }
 
+ulong gcore_arch_user_regs(struct task_context *tc)
+{
+	return machdep->get_stacktop(tc->task) -
+		machdep->machspec->user_eframe_offset - SIZE(pt_regs);
+}
+
 #endif
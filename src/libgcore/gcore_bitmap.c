@@ -0,0 +1,462 @@
+/* gcore_bitmap.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#ifdef GCORE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef GCORE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef GCORE_HAVE_LZO
+#include <lzo/lzo1x.h>
+#endif
+
+/*
+ * Excluded-page bitmap of kdump-compressed dump files.
+ *
+ * makedumpfile records which page frames it wrote in the second of
+ * the two bitmaps following the headers of the dump file; a frame
+ * whose bit is clear was excluded, as a free, cache or zero page for
+ * instance, and reading it fails or returns zeros. The copy engine
+ * looks the bitmap up right after translating an address, so that
+ * excluded pages are left as holes without being read, and the layout
+ * pre-pass can tell how much of each VMA the dump actually holds.
+ *
+ * The bitmap is mapped from the dump file once per crash session, like
+ * the PT_LOAD headers of an ELF dump file are read by the parallel
+ * copy. Split and flattened dump files are not looked into.
+ *
+ * The copy threads of -j read pages of such dump files by themselves
+ * too, without calling into crash: the page descriptor of a written
+ * page is found by counting the bits set before it in the bitmap, and
+ * the page is then read with pread() and decompressed by the thread.
+ * Counts are kept per GCORE_KDUMP_RANK_PFNS page frames to find them
+ * quickly. Dump files whose pages are compressed with a method gcore
+ * is not built with, or that makedumpfile could not complete, are
+ * left to readmem().
+ */
+
+#define GCORE_KDUMP_SIGNATURE "KDUMP   "
+#define GCORE_KDUMP_RANK_PFNS 512
+
+/* Compression of the dump file, in its status, and of each page. */
+#define DUMP_DH_COMPRESSED_ZLIB		0x1
+#define DUMP_DH_COMPRESSED_LZO		0x2
+#define DUMP_DH_COMPRESSED_SNAPPY	0x4
+#define DUMP_DH_COMPRESSED_INCOMPLETE	0x8
+#define DUMP_DH_COMPRESSED_ZSTD		0x20
+
+/*
+ * The headers as written by makedumpfile, see diskdump_mod.h there.
+ */
+struct gcore_kdump_header
+{
+	char signature[8];
+	int header_version;
+	char utsname[6 * 65];	/* struct new_utsname */
+	struct timeval timestamp;
+	unsigned int status;
+	int block_size;
+	int sub_hdr_size;	/* in blocks */
+	unsigned int bitmap_blocks;
+	unsigned int max_mapnr;	/* up to header version 5 */
+};
+
+struct gcore_kdump_sub_header
+{
+	unsigned long phys_base;
+	int dump_level;
+	int split;
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+	off_t offset_vmcoreinfo;
+	unsigned long size_vmcoreinfo;
+	off_t offset_note;
+	unsigned long size_note;
+	off_t offset_eraseinfo;
+	unsigned long size_eraseinfo;
+	unsigned long long start_pfn_64;
+	unsigned long long end_pfn_64;
+	unsigned long long max_mapnr_64;	/* from header version 6 */
+};
+
+struct gcore_kdump_page_desc
+{
+	off_t offset;		/* of the page data in the dump file */
+	unsigned int size;	/* of the page data */
+	unsigned int flags;	/* DUMP_DH_COMPRESSED_* */
+	unsigned long long page_flags;
+};
+
+struct gcore_bitmap_data
+{
+	int loaded;		/* looked for in this crash session */
+	void *map;		/* NULL if the dump file has no bitmap */
+	size_t map_len;
+	const unsigned char *bitmap;	/* of pages written */
+	ulonglong max_pfn;
+	ulong block_size;
+	unsigned int status;	/* DUMP_DH_COMPRESSED_* of the dump file */
+	off_t desc_offset;	/* of the page descriptors */
+
+	int reader;		/* pages can be read without crash */
+	ulonglong *rank;	/* bits set before each GCORE_KDUMP_RANK_PFNS */
+};
+
+static struct gcore_bitmap_data gcore_bitmap_data;
+static struct gcore_bitmap_data *gbd = &gcore_bitmap_data;
+
+static void bitmap_load(void);
+static int kdump_reader_init(void);
+static ulonglong kdump_page_index(ulonglong pfn);
+static int kdump_decompress(struct gcore_kdump_page_desc *desc,
+			    const char *src, char *dst);
+
+/**
+ * Return TRUE if the dump file tells which pages it excludes.
+ */
+int gcore_bitmap_active(void)
+{
+	if (!gbd->loaded) {
+		gbd->loaded = TRUE;
+		bitmap_load();
+	}
+
+	return gbd->bitmap != NULL;
+}
+
+/**
+ * Return TRUE if the page frame at @paddr has been excluded from the
+ * dump file, so that reading it is pointless.
+ *
+ * Precondition:
+ *
+ *   gcore_bitmap_active() has returned TRUE.
+ */
+int gcore_bitmap_excluded(physaddr_t paddr)
+{
+	ulonglong pfn = paddr / gbd->block_size;
+
+	/* Beyond the bitmap, let readmem() decide. */
+	if (pfn >= gbd->max_pfn)
+		return FALSE;
+
+	return !(gbd->bitmap[pfn >> 3] & (1 << (pfn & 7)));
+}
+
+/**
+ * Return TRUE if pages of the dump file can be read with
+ * gcore_kdump_read(), without crash.
+ */
+int gcore_kdump_active(void)
+{
+	if (!gcore_bitmap_active())
+		return FALSE;
+
+	if (!gbd->reader)
+		gbd->reader = kdump_reader_init() ? 1 : -1;
+
+	return gbd->reader > 0;
+}
+
+/**
+ * Return the size of the scratch buffer gcore_kdump_read() needs.
+ */
+size_t gcore_kdump_scratch_size(void)
+{
+	return GCORE_COPY_BATCH_PAGES * (gbd->block_size +
+		sizeof(struct gcore_kdump_page_desc)) + gbd->block_size;
+}
+
+/**
+ * Return TRUE if all the pages of [@paddr, @paddr + @len) have been
+ * written into the dump file, so that gcore_kdump_read() can read
+ * them.
+ *
+ * Precondition:
+ *
+ *   gcore_kdump_active() has returned TRUE.
+ */
+int gcore_kdump_readable(physaddr_t paddr, ulong len)
+{
+	ulonglong pfn, last = (paddr + len - 1) / gbd->block_size;
+
+	if (!len || last >= gbd->max_pfn)
+		return FALSE;
+
+	for (pfn = paddr / gbd->block_size; pfn <= last; pfn++)
+		if (!(gbd->bitmap[pfn >> 3] & (1 << (pfn & 7))))
+			return FALSE;
+
+	return TRUE;
+}
+
+/**
+ * gcore_kdump_read - read physical memory from the dump file
+ *
+ * @fd       file descriptor of the dump file
+ * @paddr    physical address to read from
+ * @buf      where to read to
+ * @len      number of bytes to read
+ * @scratch  buffer of gcore_kdump_scratch_size() bytes, private to the
+ *           calling thread
+ *
+ * This never calls into crash, and so is safe to call from several
+ * threads at once, with different scratch buffers.
+ *
+ * Precondition:
+ *
+ *   gcore_kdump_readable(@paddr, @len) has returned TRUE.
+ *
+ * Return Value:
+ *
+ *   0 on success; -1 with errno set otherwise.
+ */
+int gcore_kdump_read(int fd, physaddr_t paddr, char *buf, ulong len,
+		     char *scratch)
+{
+	ulong bs = gbd->block_size;
+	struct gcore_kdump_page_desc *desc;
+	char *cbuf, *page;
+	ulonglong pfn, end;
+
+	desc = (struct gcore_kdump_page_desc *)scratch;
+	cbuf = scratch + GCORE_COPY_BATCH_PAGES * sizeof(*desc);
+	page = cbuf + GCORE_COPY_BATCH_PAGES * bs;
+
+	end = (paddr + len + bs - 1) / bs;
+
+	for (pfn = paddr / bs; pfn < end;) {
+		ulong i, n = MIN(end - pfn, GCORE_COPY_BATCH_PAGES);
+		off_t start;
+		size_t span;
+		int contiguous = TRUE;
+
+		/* Written pages in a row have descriptors in a row. */
+		if (pread(fd, desc, n * sizeof(*desc), gbd->desc_offset +
+			  kdump_page_index(pfn) * sizeof(*desc))
+		    != (ssize_t)(n * sizeof(*desc)))
+			goto eio;
+
+		for (i = 0; i < n; i++) {
+			if (desc[i].size > bs || !desc[i].offset)
+				goto eio;
+			if (i && desc[i].offset !=
+			    desc[i - 1].offset + desc[i - 1].size)
+				contiguous = FALSE;
+		}
+
+		/* makedumpfile writes them in a row too, usually. */
+		start = desc[0].offset;
+		span = desc[n - 1].offset + desc[n - 1].size - start;
+		if (contiguous) {
+			if (pread(fd, cbuf, span, start) != (ssize_t)span)
+				goto eio;
+		} else {
+			for (i = 0; i < n; i++) {
+				ssize_t size = desc[i].size;
+
+				if (pread(fd, cbuf + i * bs, size,
+					  desc[i].offset) != size)
+					goto eio;
+			}
+		}
+
+		for (i = 0; i < n; i++, pfn++) {
+			physaddr_t base = pfn * bs;
+			const char *src = contiguous ?
+				cbuf + (desc[i].offset - start) : cbuf + i * bs;
+			int whole = base >= paddr && base + bs <= paddr + len;
+			char *dst = whole ? buf + (base - paddr) : page;
+
+			if (!kdump_decompress(&desc[i], src, dst))
+				goto eio;
+
+			if (!whole) {
+				physaddr_t from = MAX(base, paddr);
+				physaddr_t to = MIN(base + bs, paddr + len);
+
+				memcpy(buf + (from - paddr), page +
+				       (from - base), to - from);
+			}
+		}
+	}
+
+	return 0;
+
+eio:
+	errno = EIO;
+	return -1;
+}
+
+/*
+ * Map the second bitmap of a kdump-compressed dump file, if that is
+ * what the dump file is.
+ */
+static void bitmap_load(void)
+{
+	struct gcore_kdump_header h;
+	struct gcore_kdump_sub_header sh;
+	off_t offset, start;
+	size_t len;
+	int fd;
+
+	if (!pc->dumpfile || !DISKDUMP_DUMPFILE())
+		return;
+
+	if ((fd = open(pc->dumpfile, O_RDONLY)) < 0)
+		return;
+
+	if (pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+	    memcmp(h.signature, GCORE_KDUMP_SIGNATURE, sizeof(h.signature)) ||
+	    h.block_size <= 0 || h.sub_hdr_size <= 0 || !h.bitmap_blocks ||
+	    pread(fd, &sh, sizeof(sh), h.block_size) != sizeof(sh) ||
+	    sh.split)
+		goto out;
+
+	gbd->block_size = h.block_size;
+	gbd->max_pfn = h.header_version >= 6 ? sh.max_mapnr_64 : h.max_mapnr;
+	gbd->status = h.status;
+	gbd->desc_offset = (off_t)h.block_size *
+		(1 + h.sub_hdr_size + h.bitmap_blocks);
+
+	/* The first bitmap, of RAM pages, then the second one. */
+	len = (size_t)h.block_size * h.bitmap_blocks / 2;
+	offset = (off_t)h.block_size * (1 + h.sub_hdr_size) + len;
+	if ((gbd->max_pfn + 7) / 8 > len)
+		goto out;
+
+	start = offset & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+	gbd->map_len = len + (offset - start);
+	gbd->map = mmap(NULL, gbd->map_len, PROT_READ, MAP_PRIVATE, fd, start);
+	if (gbd->map == MAP_FAILED) {
+		gbd->map = NULL;
+		goto out;
+	}
+	gbd->bitmap = (const unsigned char *)gbd->map + (offset - start);
+
+	progressf("kdump bitmap: %llu page frames of %lu bytes\n",
+		  gbd->max_pfn, gbd->block_size);
+out:
+	close(fd);
+}
+
+/*
+ * Check that pages of the dump file can be decompressed without crash,
+ * and count the bits set in the bitmap. The counts are kept for the
+ * crash session, like the bitmap.
+ */
+static int kdump_reader_init(void)
+{
+	ulonglong i, nr, count;
+
+	if (gbd->block_size != PAGE_SIZE ||
+	    (gbd->status & DUMP_DH_COMPRESSED_INCOMPLETE) ||
+	    (gbd->status & DUMP_DH_COMPRESSED_SNAPPY))
+		goto unsupported;
+#ifndef GCORE_HAVE_ZLIB
+	if (gbd->status & DUMP_DH_COMPRESSED_ZLIB)
+		goto unsupported;
+#endif
+#ifdef GCORE_HAVE_LZO
+	if ((gbd->status & DUMP_DH_COMPRESSED_LZO) && lzo_init() != LZO_E_OK)
+		goto unsupported;
+#else
+	if (gbd->status & DUMP_DH_COMPRESSED_LZO)
+		goto unsupported;
+#endif
+#ifndef GCORE_HAVE_ZSTD
+	if (gbd->status & DUMP_DH_COMPRESSED_ZSTD)
+		goto unsupported;
+#endif
+
+	nr = (gbd->max_pfn + GCORE_KDUMP_RANK_PFNS - 1) /
+		GCORE_KDUMP_RANK_PFNS;
+	if (!(gbd->rank = malloc(nr * sizeof(ulonglong))))
+		goto unsupported;
+
+	for (i = count = 0; i < (gbd->max_pfn + 7) / 8; i++) {
+		if (!(i % (GCORE_KDUMP_RANK_PFNS / 8)))
+			gbd->rank[i / (GCORE_KDUMP_RANK_PFNS / 8)] = count;
+		count += __builtin_popcount(gbd->bitmap[i]);
+	}
+
+	progressf("kdump reader: %llu pages written, status %x\n", count,
+		  gbd->status);
+	return TRUE;
+
+unsupported:
+	progressf("kdump reader: not supported for this dump file "
+		  "(block size %lu, status %x)\n", gbd->block_size,
+		  gbd->status);
+	return FALSE;
+}
+
+/*
+ * Return the index of the page descriptor of the page frame @pfn,
+ * which has been written into the dump file.
+ */
+static ulonglong kdump_page_index(ulonglong pfn)
+{
+	ulonglong i, index = gbd->rank[pfn / GCORE_KDUMP_RANK_PFNS];
+
+	for (i = pfn / GCORE_KDUMP_RANK_PFNS * (GCORE_KDUMP_RANK_PFNS / 8);
+	     i < pfn / 8; i++)
+		index += __builtin_popcount(gbd->bitmap[i]);
+
+	return index + __builtin_popcount(gbd->bitmap[pfn / 8] &
+					  ((1 << (pfn & 7)) - 1));
+}
+
+/*
+ * Decompress the page described by @desc from @src into the
+ * block_size bytes at @dst.
+ */
+static int kdump_decompress(struct gcore_kdump_page_desc *desc,
+			    const char *src, char *dst)
+{
+	ulong bs = gbd->block_size;
+
+	if (desc->flags & DUMP_DH_COMPRESSED_ZLIB) {
+#ifdef GCORE_HAVE_ZLIB
+		uLongf n = bs;
+
+		return uncompress((Bytef *)dst, &n, (const Bytef *)src,
+				  desc->size) == Z_OK && n == bs;
+#endif
+	} else if (desc->flags & DUMP_DH_COMPRESSED_LZO) {
+#ifdef GCORE_HAVE_LZO
+		lzo_uint n = bs;
+
+		return lzo1x_decompress_safe((const lzo_bytep)src, desc->size,
+					     (lzo_bytep)dst, &n, NULL)
+			== LZO_E_OK && n == bs;
+#endif
+	} else if (desc->flags & DUMP_DH_COMPRESSED_ZSTD) {
+#ifdef GCORE_HAVE_ZSTD
+		return ZSTD_decompress(dst, bs, src, desc->size) == bs;
+#endif
+	} else if (!(desc->flags & DUMP_DH_COMPRESSED_SNAPPY) &&
+		   desc->size == bs) {
+		memcpy(dst, src, bs);
+		return TRUE;
+	}
+
+	return FALSE;
+}
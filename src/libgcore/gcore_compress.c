@@ -0,0 +1,275 @@
+/* gcore_compress.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+
+#ifdef GCORE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef GCORE_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef GCORE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/*
+ * Compression of the core file into independent frames.
+ *
+ * Each frame is a complete zstd frame, lz4 frame or gzip member, so
+ * the concatenation of frames is a valid stream for the standard
+ * decompressors and restores the ELF core file as is. For zstd and
+ * lz4, the writer appends a seek table in the zstd seekable format,
+ * which is a skippable frame that both decompressors ignore, so that
+ * a reader can also decompress any frame on demand.
+ */
+
+struct gcore_compress
+{
+	int codec;
+	int level;
+#ifdef GCORE_HAVE_ZSTD
+	ZSTD_CCtx *zstd;
+#endif
+};
+
+#ifdef GCORE_HAVE_ZSTD
+#define ZSTD_AVAILABLE TRUE
+#else
+#define ZSTD_AVAILABLE FALSE
+#endif
+#ifdef GCORE_HAVE_LZ4
+#define LZ4_AVAILABLE TRUE
+#else
+#define LZ4_AVAILABLE FALSE
+#endif
+#ifdef GCORE_HAVE_ZLIB
+#define GZIP_AVAILABLE TRUE
+#else
+#define GZIP_AVAILABLE FALSE
+#endif
+
+static struct gcore_compress_codec
+{
+	char *name;
+	char *suffix;
+	int seekable;		/* frames can be listed in a seek table */
+	int available;		/* built in */
+	int default_level;
+} gcore_compress_codecs[GCORE_COMPRESS_NR_CODECS] = {
+	[GCORE_COMPRESS_NONE] = { "none", "", FALSE, TRUE, 0 },
+	[GCORE_COMPRESS_ZSTD] = { "zstd", ".zst", TRUE, ZSTD_AVAILABLE, 3 },
+	[GCORE_COMPRESS_LZ4] = { "lz4", ".lz4", TRUE, LZ4_AVAILABLE, 0 },
+	[GCORE_COMPRESS_GZIP] = { "gzip", ".gz", FALSE, GZIP_AVAILABLE, 1 },
+};
+
+/**
+ * Look up a codec by @name.
+ *
+ * Return Value:
+ *
+ *   The codec, or -1 if @name is unknown.
+ */
+int gcore_compress_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < GCORE_COMPRESS_NR_CODECS; i++)
+		if (STREQ(name, gcore_compress_codecs[i].name))
+			return i;
+
+	return -1;
+}
+
+/**
+ * Return whether @codec has been built in.
+ */
+int gcore_compress_available(int codec)
+{
+	return gcore_compress_codecs[codec].available;
+}
+
+/**
+ * Return the file name suffix for @codec, such as ".zst".
+ */
+const char *gcore_compress_suffix(int codec)
+{
+	return gcore_compress_codecs[codec].suffix;
+}
+
+/**
+ * Set up compression with @codec at @level, or at the default level of
+ * the codec if @level is 0. @threads, if more than 1, is the number of
+ * threads compressing each frame, and is used by zstd only.
+ *
+ * Return Value:
+ *
+ *   The compressor, or NULL with errno set.
+ */
+struct gcore_compress *gcore_compress_init(int codec, int level, int threads)
+{
+	struct gcore_compress *c;
+
+	if (codec <= GCORE_COMPRESS_NONE || codec >= GCORE_COMPRESS_NR_CODECS
+	    || !gcore_compress_codecs[codec].available) {
+		errno = ENOSYS;
+		return NULL;
+	}
+
+	if (!(c = calloc(1, sizeof(*c))))
+		return NULL;
+
+	c->codec = codec;
+	c->level = level ? level : gcore_compress_codecs[codec].default_level;
+
+#ifdef GCORE_HAVE_ZSTD
+	if (codec == GCORE_COMPRESS_ZSTD) {
+		if (!(c->zstd = ZSTD_createCCtx())) {
+			free(c);
+			errno = ENOMEM;
+			return NULL;
+		}
+		ZSTD_CCtx_setParameter(c->zstd, ZSTD_c_compressionLevel,
+				       c->level);
+		ZSTD_CCtx_setParameter(c->zstd, ZSTD_c_contentSizeFlag, 1);
+		/*
+		 * Fails without effect if libzstd is built without
+		 * multithread support.
+		 */
+		if (threads > 1)
+			ZSTD_CCtx_setParameter(c->zstd, ZSTD_c_nbWorkers,
+					       threads);
+	}
+#endif
+
+	return c;
+}
+
+/**
+ * Return whether frames of @c are listed in a seek table.
+ */
+int gcore_compress_seekable(struct gcore_compress *c)
+{
+	return gcore_compress_codecs[c->codec].seekable;
+}
+
+/**
+ * Return the largest size of a frame holding @len bytes.
+ */
+size_t gcore_compress_bound(struct gcore_compress *c, size_t len)
+{
+	switch (c->codec) {
+#ifdef GCORE_HAVE_ZSTD
+	case GCORE_COMPRESS_ZSTD:
+		return ZSTD_compressBound(len);
+#endif
+#ifdef GCORE_HAVE_LZ4
+	case GCORE_COMPRESS_LZ4:
+		return LZ4F_compressFrameBound(len, NULL);
+#endif
+#ifdef GCORE_HAVE_ZLIB
+	case GCORE_COMPRESS_GZIP:
+		/* deflateBound() plus the gzip header and trailer */
+		return compressBound(len) + 18;
+#endif
+	}
+
+	return len;
+}
+
+/**
+ * Compress @len bytes of @src into one frame in @dst of @size bytes,
+ * which is at least gcore_compress_bound(@c, @len).
+ *
+ * Return Value:
+ *
+ *   The size of the frame, or 0 with errno set.
+ */
+size_t gcore_compress_frame(struct gcore_compress *c, void *dst, size_t size,
+			    const void *src, size_t len)
+{
+	switch (c->codec) {
+#ifdef GCORE_HAVE_ZSTD
+	case GCORE_COMPRESS_ZSTD: {
+		size_t n;
+
+		n = ZSTD_compress2(c->zstd, dst, size, src, len);
+		if (ZSTD_isError(n)) {
+			error(INFO, "zstd: %s\n", ZSTD_getErrorName(n));
+			errno = EIO;
+			return 0;
+		}
+		return n;
+	}
+#endif
+#ifdef GCORE_HAVE_LZ4
+	case GCORE_COMPRESS_LZ4: {
+		LZ4F_preferences_t prefs;
+		size_t n;
+
+		BZERO(&prefs, sizeof(prefs));
+		prefs.compressionLevel = c->level;
+		prefs.frameInfo.contentSize = len;
+		prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+
+		n = LZ4F_compressFrame(dst, size, src, len, &prefs);
+		if (LZ4F_isError(n)) {
+			error(INFO, "lz4: %s\n", LZ4F_getErrorName(n));
+			errno = EIO;
+			return 0;
+		}
+		return n;
+	}
+#endif
+#ifdef GCORE_HAVE_ZLIB
+	case GCORE_COMPRESS_GZIP: {
+		z_stream z;
+		int ret;
+
+		BZERO(&z, sizeof(z));
+		/* windowBits + 16 produces a gzip member. */
+		if (deflateInit2(&z, c->level, Z_DEFLATED, 15 + 16, 8,
+				 Z_DEFAULT_STRATEGY) != Z_OK) {
+			errno = ENOMEM;
+			return 0;
+		}
+		z.next_in = (Bytef *)src;
+		z.avail_in = len;
+		z.next_out = dst;
+		z.avail_out = size;
+		ret = deflate(&z, Z_FINISH);
+		deflateEnd(&z);
+		if (ret != Z_STREAM_END) {
+			errno = EIO;
+			return 0;
+		}
+		return z.total_out;
+	}
+#endif
+	}
+
+	errno = ENOSYS;
+	return 0;
+}
+
+void gcore_compress_exit(struct gcore_compress *c)
+{
+#ifdef GCORE_HAVE_ZSTD
+	if (c->zstd)
+		ZSTD_freeCCtx(c->zstd);
+#endif
+	free(c);
+}
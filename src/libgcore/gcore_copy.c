@@ -0,0 +1,949 @@
+/* gcore_copy.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+
+/*
+ * Data used by the copy engine during one session. The buffer and the
+ * translation window are allocated by gcore_copy_init() with GETBUF()
+ * and so released by free_all_bufs() at the end of each session.
+ */
+struct gcore_copy_data
+{
+	char *buffer;
+	physaddr_t *paddr;
+	char *present;
+	int arch_vtop;
+	int parallel;
+	int dedup;		/* pages may come from earlier cores */
+	ulong zero_pfn;		/* the shared zero page, or ~0UL */
+	ulong huge_zero_pfn;	/* the huge zero page, or ~0UL */
+	off_t offset;		/* core file offset, in parallel mode */
+	int tolerant;		/* leave unreadable pages as holes */
+	int bitmap;		/* the dump file tells excluded pages */
+	ulong *bad;		/* [start, end) pairs of unreadable pages */
+	ulong nr_bad;
+	ulong max_bad;
+	struct gcore_copy_stats stats;
+};
+
+static struct gcore_copy_data gcore_copy_data;
+static struct gcore_copy_data *gcd = &gcore_copy_data;
+
+static int (*page_is_zero)(const char *page);
+
+/*
+ * States of a page in the translation window.
+ */
+#define COPY_FAULTED	0	/* not present; left as a hole */
+#define COPY_PRESENT	1	/* present; read from the dump */
+#define COPY_ZERO_PFN	2	/* maps the zero page; left as a hole */
+#define COPY_EXCLUDED	3	/* not in the dump file; left as a hole */
+
+static int uvtop_quiet(ulong vaddr, physaddr_t *paddr);
+static int copy_vtop(ulong vaddr, physaddr_t *paddr, ulong *size);
+static void copy_zero_pfn_init(void);
+static void copy_zero_page_init(void);
+static int copy_is_zero_pfn(ulong vaddr, physaddr_t paddr, ulong size);
+
+static void copy_present_run(ulong addr, int first, int last);
+static void copy_read(ulong vaddr, physaddr_t paddr, char *buf,
+		      int nr_pages);
+static void copy_add_bad(ulong vaddr, physaddr_t paddr);
+static void copy_merge_bad(void);
+static void copy_dedup_pages(int src_fd, off_t src, int nr_pages, off_t dst);
+static void copy_write_pages(char *buf, int nr_pages, off_t dst);
+static void copy_faulted_run(ulong addr, int first, int last);
+static void copy_zero_pfn_run(ulong addr, int first, int last);
+static void copy_excluded_run(int first, int last);
+
+/**
+ * Prepare the copy engine for a new session.
+ *
+ * Precondition:
+ *
+ *   Nothing.
+ *
+ * Postcondition:
+ *
+ *   - A copy buffer of GCORE_COPY_BATCH_PAGES pages and the
+ *     translation window for the same number of pages are allocated.
+ *   - The architecture's page-table walker is used if available.
+ *   - The page frames of the zero page and the huge zero page are
+ *     known if the kernel exports them.
+ *   - Worker threads are running if requested by -j and supported
+ *     by the dump file format and the output options; then data is
+ *     written by pwrite() and the position of gcore->writer is only
+ *     updated by gcore_copy_finish().
+ *   - Pages already written into an earlier core of this command are
+ *     copied from there if requested by -o dedup.
+ *   - Pages that cannot be read are left as holes if requested by
+ *     -o tolerant.
+ *   - Pages excluded from a kdump-compressed dump file are known
+ *     from its bitmap, if it has one.
+ *   - All statistics are zero.
+ */
+void gcore_copy_init(void)
+{
+	BZERO(gcd, sizeof(*gcd));
+
+	gcd->buffer = GETBUF(GCORE_COPY_BATCH_PAGES * PAGE_SIZE);
+	gcd->paddr = (physaddr_t *)GETBUF(GCORE_COPY_BATCH_PAGES *
+					  sizeof(physaddr_t));
+	gcd->present = GETBUF(GCORE_COPY_BATCH_PAGES);
+
+	gcd->arch_vtop = gcore_arch_vtop_init();
+	copy_zero_pfn_init();
+	copy_zero_page_init();
+	gcore_pagefault_init();
+
+	gcd->dedup = gcore_dedup_begin(gcore->writer, gcore->corename);
+	gcd->tolerant = gcore_writer_tolerant();
+	gcd->bitmap = gcore_bitmap_active();
+
+	if (gcore_parallel_get() > 1 &&
+	    gcore_writer_fd(gcore->writer) >= 0) {
+		if (!gcore_writer_flush(gcore->writer))
+			error(FATAL, "%s: write: %s\n", gcore->corename,
+			      strerror(errno));
+		gcd->offset = gcore_writer_tell(gcore->writer);
+		gcd->parallel =
+			gcore_parallel_start(gcore_writer_fd(gcore->writer));
+	}
+}
+
+/**
+ * Prepare gcore_copy_scan() for a layout pre-pass over the current
+ * task, before gcore_copy_init().
+ */
+void gcore_copy_scan_init(void)
+{
+	BZERO(gcd, sizeof(*gcd));
+
+	gcd->arch_vtop = gcore_arch_vtop_init();
+	gcd->bitmap = gcore_bitmap_active();
+}
+
+/**
+ * Return the first address in [@addr, @end) whose page is present if
+ * @present is TRUE, or page-faulted if FALSE; @end if there is none.
+ * Pages excluded from the dump file count as page-faulted.
+ *
+ * A translation that hits a huge page or a non-present upper-level
+ * entry skips all the pages it maps at once, so sparse address spaces
+ * are scanned in a few steps per table.
+ */
+ulong gcore_copy_scan(ulong addr, ulong end, int present)
+{
+	while (addr < end) {
+		physaddr_t paddr;
+		ulong size, next;
+		int mapped;
+
+		mapped = copy_vtop(addr, &paddr, &size);
+
+		/* Stop at @end, also if wrapped around at the top. */
+		next = (addr & ~(size - 1)) + size;
+		if (next <= addr || next > end)
+			next = end;
+
+		if (!mapped || !gcd->bitmap) {
+			if (!mapped == !present)
+				return addr;
+			addr = next;
+			continue;
+		}
+
+		/* Look up the frames of a present mapping one by one. */
+		for (; addr < next; addr += PAGE_SIZE, paddr += PAGE_SIZE)
+			if (!gcore_bitmap_excluded(paddr) == !!present)
+				return addr;
+	}
+
+	return end;
+}
+
+/**
+ * Return how many bytes of [@start, @end) are present and not excluded
+ * from the dump file, that is, can be recovered from it.
+ */
+ulong gcore_copy_recoverable(ulong start, ulong end)
+{
+	ulong addr, next, bytes = 0;
+
+	for (addr = start; addr < end; addr = next) {
+		addr = gcore_copy_scan(addr, end, TRUE);
+		next = gcore_copy_scan(addr, end, FALSE);
+		bytes += next - addr;
+	}
+
+	return bytes;
+}
+
+/**
+ * Wait for the copy started by gcore_copy_range() to complete.
+ *
+ * Postcondition:
+ *
+ *   All data has been written and gcore->writer is positioned at the end
+ *   of the last range. Pages the copy threads could not read with
+ *   -o tolerant are in gcore_copy_get_bad_ranges() too.
+ */
+void gcore_copy_finish(void)
+{
+	int err;
+
+	if (!gcd->parallel)
+		return;
+
+	gcd->parallel = FALSE;
+
+	err = gcore_parallel_finish();
+	gcd->stats.zero += gcore_parallel_zero_pages();
+	copy_merge_bad();
+	if (err)
+		error(FATAL, "%s: copy: %s\n", gcore->corename,
+		      strerror(err));
+
+	if (!gcore_writer_seek(gcore->writer, gcd->offset))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+}
+
+/**
+ * Copy user memory [@start, @end) to the current position of
+ * gcore->writer.
+ *
+ * @start page-aligned user virtual address to begin with
+ * @end   page-aligned user virtual address to end with
+ *
+ * The range is processed in windows of GCORE_COPY_BATCH_PAGES pages
+ * aligned on the same virtual boundary, so that a 2MB huge page falls
+ * into exactly one window. All the pages in a window are translated
+ * first; a translation that hits a huge page, or a non-present
+ * upper-level entry, covers all the following pages it maps. Then
+ * each run of present pages is read with one readmem() per physically
+ * contiguous sub-run and written with a single write, and each run of
+ * page-faulted pages is skipped as a single hole.
+ *
+ * Pages mapping the kernel's zero page are not read at all, and pages
+ * found to be all zeros once read are not written; both are left as
+ * holes just like page-faulted pages. So are pages whose frames the
+ * dump file's bitmap says were excluded from it.
+ */
+void gcore_copy_range(ulong start, ulong end)
+{
+	ulong addr;
+
+	for (addr = start; addr < end;) {
+		int i, n, first;
+
+		n = GCORE_COPY_BATCH_PAGES
+			- (addr / PAGE_SIZE) % GCORE_COPY_BATCH_PAGES;
+		n = MIN(n, (end - addr) / PAGE_SIZE);
+
+		for (i = 0; i < n;) {
+			ulong vaddr = addr + i * PAGE_SIZE;
+			ulong size;
+			int j, covered;
+
+			gcd->present[i] = copy_vtop(vaddr, &gcd->paddr[i],
+						    &size);
+
+			covered = (size - (vaddr & (size - 1))) / PAGE_SIZE;
+			covered = MIN(covered, n - i);
+			if (size > PAGE_SIZE && gcd->present[i])
+				gcd->stats.huge++;
+			if (gcd->present[i] &&
+			    copy_is_zero_pfn(vaddr, gcd->paddr[i], size))
+				gcd->present[i] = COPY_ZERO_PFN;
+
+			for (j = 1; j < covered; j++) {
+				gcd->present[i + j] = gcd->present[i];
+				gcd->paddr[i + j] = gcd->paddr[i] + j * PAGE_SIZE;
+			}
+			for (j = 0; gcd->bitmap && j < covered; j++) {
+				if (gcd->present[i + j] == COPY_PRESENT &&
+				    gcore_bitmap_excluded(gcd->paddr[i + j]))
+					gcd->present[i + j] = COPY_EXCLUDED;
+			}
+			i += covered;
+		}
+
+		for (first = 0; first < n; first = i) {
+			for (i = first + 1; i < n; i++)
+				if (gcd->present[i] != gcd->present[first])
+					break;
+
+			switch (gcd->present[first]) {
+			case COPY_PRESENT:
+				copy_present_run(addr, first, i);
+				break;
+			case COPY_ZERO_PFN:
+				copy_zero_pfn_run(addr, first, i);
+				break;
+			case COPY_EXCLUDED:
+				copy_excluded_run(first, i);
+				break;
+			default:
+				copy_faulted_run(addr, first, i);
+				break;
+			}
+		}
+
+		gcd->stats.pages += n;
+		addr += n * PAGE_SIZE;
+	}
+
+	/* Fault ranges are reported per segment. */
+	gcore_pagefault_flush();
+}
+
+/**
+ * Leave out @len bytes of the core, already copied by an earlier run,
+ * without touching them.
+ */
+void gcore_copy_skip(ulong len)
+{
+	if (gcd->parallel)
+		gcd->offset += len;
+	else if (!gcore_writer_skip(gcore->writer, len))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+}
+
+/**
+ * Wait for all data copied so far to be written to the core file,
+ * by the copy threads too.
+ */
+void gcore_copy_sync(void)
+{
+	int err;
+
+	if (gcd->parallel && (err = gcore_parallel_drain()))
+		error(FATAL, "%s: copy: %s\n", gcore->corename,
+		      strerror(err));
+
+	if (!gcore_writer_flush(gcore->writer))
+		error(FATAL, "%s: write: %s\n", gcore->corename,
+		      strerror(errno));
+}
+
+/*
+ * Pages [@first, @last) of the current window are all present. Merge
+ * those whose physical frames are contiguous into one read, and write
+ * the whole run out at once, except for all-zero pages.
+ *
+ * In parallel mode, each physically contiguous sub-run is handed to
+ * the worker threads with its final file offset instead; only the
+ * sub-runs they cannot read are read here, and written in place.
+ *
+ * With dedup, pages found in an earlier core are copied from there
+ * instead of being read, and the others are recorded once written.
+ */
+static void copy_present_run(ulong addr, int first, int last)
+{
+	off_t base;
+	int i, j, pending;
+
+	base = gcd->parallel ? gcd->offset : gcore_writer_tell(gcore->writer);
+	pending = first;
+
+	for (i = first; i < last; i = j) {
+		char *buf = gcd->buffer + (i - first) * PAGE_SIZE;
+		off_t dst = base + (i - first) * PAGE_SIZE;
+		ulong len;
+
+		for (j = i + 1; j < last; j++)
+			if (gcd->paddr[j] != gcd->paddr[j - 1] + PAGE_SIZE)
+				break;
+
+		if (gcd->dedup) {
+			off_t src;
+			int fd, n;
+
+			n = gcore_dedup_find(&gcd->paddr[i], j - i, &fd, &src);
+			if (n) {
+				char *p = gcd->buffer +
+					(pending - first) * PAGE_SIZE;
+
+				if (!gcd->parallel && pending < i)
+					copy_write_pages(p, i - pending, 0);
+				copy_dedup_pages(fd, src, n, dst);
+				pending = j = i + n;
+				continue;
+			}
+			for (n = 1; n < j - i; n++)
+				if (gcore_dedup_find(&gcd->paddr[i + n], 1,
+						     &fd, &src))
+					break;
+			j = i + n;
+			gcore_dedup_add(&gcd->paddr[i], j - i, dst);
+		}
+		len = (j - i) * PAGE_SIZE;
+
+		gcd->stats.reads++;
+
+		if (gcd->parallel &&
+		    gcore_parallel_submit(addr + i * PAGE_SIZE, gcd->paddr[i],
+					  len, dst))
+			continue;
+
+		copy_read(addr + i * PAGE_SIZE, gcd->paddr[i], buf, j - i);
+
+		if (gcd->parallel)
+			copy_write_pages(buf, j - i, dst);
+	}
+
+	gcd->stats.present += last - first;
+
+	if (gcd->parallel) {
+		gcd->offset += (last - first) * PAGE_SIZE;
+		return;
+	}
+
+	if (pending < last)
+		copy_write_pages(gcd->buffer + (pending - first) * PAGE_SIZE,
+				 last - pending, 0);
+}
+
+/*
+ * Read the @nr_pages pages at @paddr, mapped at @vaddr, into @buf. With
+ * -o tolerant, a failed read is retried page by page, and pages that
+ * still cannot be read are zeroed, so that they are left as holes, and
+ * recorded; otherwise, a failed read aborts the core.
+ */
+static void copy_read(ulong vaddr, physaddr_t paddr, char *buf, int nr_pages)
+{
+	int i;
+
+	if (!gcd->tolerant) {
+		gcore_readmem(paddr, PHYSADDR, buf, nr_pages * PAGE_SIZE,
+			      "readmem vma list", gcore_verbose_error_handle());
+		return;
+	}
+
+	if (gcore_readmem(paddr, PHYSADDR, buf, nr_pages * PAGE_SIZE,
+			  "readmem vma list", RETURN_ON_ERROR|QUIET))
+		return;
+
+	for (i = 0; i < nr_pages; i++) {
+		char *p = buf + i * PAGE_SIZE;
+
+		if (gcore_readmem(paddr + i * PAGE_SIZE, PHYSADDR, p,
+				  PAGE_SIZE, "readmem vma list",
+				  RETURN_ON_ERROR|QUIET))
+			continue;
+		BZERO(p, PAGE_SIZE);
+		copy_add_bad(vaddr + i * PAGE_SIZE, paddr + i * PAGE_SIZE);
+	}
+}
+
+/*
+ * Record the unreadable page at @vaddr, extending the last range if
+ * it is contiguous. With dedup, its frame at @paddr is no longer
+ * offered to later cores, which would copy zeros from this one.
+ */
+static void copy_add_bad(ulong vaddr, physaddr_t paddr)
+{
+	gcd->stats.bad++;
+
+	if (gcd->dedup)
+		gcore_dedup_forget(paddr);
+
+	if (gcd->nr_bad && gcd->bad[2 * gcd->nr_bad - 1] == vaddr) {
+		gcd->bad[2 * gcd->nr_bad - 1] += PAGE_SIZE;
+		return;
+	}
+
+	if (gcd->nr_bad == gcd->max_bad) {
+		ulong max = gcd->max_bad ? 2 * gcd->max_bad : 64;
+		ulong *bad = (ulong *)GETBUF(2 * max * sizeof(ulong));
+
+		if (gcd->nr_bad) {
+			memcpy(bad, gcd->bad, 2 * gcd->nr_bad * sizeof(ulong));
+			FREEBUF(gcd->bad);
+		}
+		gcd->bad = bad;
+		gcd->max_bad = max;
+	}
+
+	gcd->bad[2 * gcd->nr_bad] = vaddr;
+	gcd->bad[2 * gcd->nr_bad + 1] = vaddr + PAGE_SIZE;
+	gcd->nr_bad++;
+}
+
+static int copy_compare_bad(const void *a, const void *b)
+{
+	const ulong *x = a, *y = b;
+
+	return x[0] < y[0] ? -1 : x[0] > y[0];
+}
+
+/*
+ * Add the pages the copy threads could not read to those read here,
+ * and sort and coalesce the ranges again, as they come in any order.
+ */
+static void copy_merge_bad(void)
+{
+	struct gcore_parallel_bad *pages;
+	ulong i, j, nr;
+
+	if (!(nr = gcore_parallel_bad_pages(&pages)))
+		return;
+
+	for (i = 0; i < nr; i++)
+		copy_add_bad(pages[i].vaddr, pages[i].paddr);
+
+	qsort(gcd->bad, gcd->nr_bad, 2 * sizeof(ulong), copy_compare_bad);
+
+	for (i = 0, j = 1; j < gcd->nr_bad; j++) {
+		if (gcd->bad[2 * i + 1] == gcd->bad[2 * j]) {
+			gcd->bad[2 * i + 1] = gcd->bad[2 * j + 1];
+			continue;
+		}
+		i++;
+		gcd->bad[2 * i] = gcd->bad[2 * j];
+		gcd->bad[2 * i + 1] = gcd->bad[2 * j + 1];
+	}
+	gcd->nr_bad = i + 1;
+}
+
+/**
+ * Return the number of ranges of unreadable pages left as holes since
+ * gcore_copy_init(), and set *@ranges to their start and end addresses,
+ * in pairs.
+ */
+ulong gcore_copy_get_bad_ranges(ulong **ranges)
+{
+	*ranges = gcd->bad;
+	return gcd->nr_bad;
+}
+
+/*
+ * Copy @nr_pages pages at @src of an earlier core into the core file
+ * at @dst in parallel mode, or at the current position otherwise.
+ */
+static void copy_dedup_pages(int src_fd, off_t src, int nr_pages, off_t dst)
+{
+	struct gcore_writer *w = gcore->writer;
+	ulong len = nr_pages * PAGE_SIZE;
+
+	if (!gcd->parallel) {
+		if (!gcore_writer_flush(w))
+			error(FATAL, "%s: write: %s\n", gcore->corename,
+			      strerror(errno));
+		dst = gcore_writer_tell(w);
+	}
+
+	if (!gcore_dedup_copy(src_fd, src, gcore_writer_fd(w), dst, len))
+		error(FATAL, "%s: copy: %s\n", gcore->corename,
+		      strerror(errno));
+
+	/* The data is in the file; only move past it. */
+	if (!gcd->parallel && !gcore_writer_skip(w, len))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+
+	gcd->stats.dedup += nr_pages;
+}
+
+/*
+ * Write @nr_pages pages in @buf, leaving runs of all-zero pages as
+ * holes. In parallel mode the pages go to the core file offset @dst;
+ * otherwise they are appended to gcore->writer and @dst is unused.
+ */
+static void copy_write_pages(char *buf, int nr_pages, off_t dst)
+{
+	int i, j, zero;
+
+	for (i = 0; i < nr_pages; i = j) {
+		char *p = buf + i * PAGE_SIZE;
+		ulong len;
+		int ok;
+
+		zero = gcore_page_is_zero(p);
+		for (j = i + 1; j < nr_pages; j++)
+			if (gcore_page_is_zero(buf + j * PAGE_SIZE) != zero)
+				break;
+		len = (j - i) * PAGE_SIZE;
+
+		if (zero) {
+			gcd->stats.zero += j - i;
+			if (!gcd->parallel &&
+			    !gcore_writer_skip(gcore->writer, len))
+				error(FATAL, "%s: seek: %s\n", gcore->corename,
+				      strerror(errno));
+			continue;
+		}
+
+		if (gcd->parallel)
+			ok = gcore_writer_pwrite(gcore->writer, p, len,
+						 dst + i * PAGE_SIZE);
+		else
+			ok = gcore_writer_write(gcore->writer, p, len);
+		if (!ok)
+			error(FATAL, "%s: write: %s\n", gcore->corename,
+			      strerror(errno));
+		gcd->stats.writes++;
+	}
+}
+
+/*
+ * Pages [@first, @last) of the current window are all page-faulted.
+ */
+static void copy_faulted_run(ulong addr, int first, int last)
+{
+	gcore_pagefault(addr + first * PAGE_SIZE, last - first);
+
+	/* Fill unavailable page-faulted pages with 0 for ease of
+	 * implementation; to be honest, I want to avoid restructuring
+	 * program header table.
+	 *
+	 * Also, we do skip these pages as holes. Recent filesystems
+	 * support sparse file that doesn't allocate actual blocks if
+	 * there are no corresponding write; such part is called
+	 * hole. Hence, the skip works just like a filter for
+	 * page-faulted pages.
+	 *
+	 * Note, however, that we don't reedit program headers and
+	 * these pages are logically present on corefile as
+	 * zero-filled pages. If copying the corefile on system that
+	 * doesn't support sparse file, resulting corefile can be much
+	 * larger than original size.
+	 */
+	if (gcd->parallel)
+		gcd->offset += (last - first) * PAGE_SIZE;
+	else if (!gcore_writer_skip(gcore->writer, (last - first) * PAGE_SIZE))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+	gcd->stats.holes++;
+	gcd->stats.faulted += last - first;
+}
+
+/*
+ * Pages [@first, @last) of the current window all map the zero page
+ * or the huge zero page, so their contents are known without reading
+ * them.
+ */
+static void copy_zero_pfn_run(ulong addr, int first, int last)
+{
+	if (gcd->parallel)
+		gcd->offset += (last - first) * PAGE_SIZE;
+	else if (!gcore_writer_skip(gcore->writer, (last - first) * PAGE_SIZE))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+	gcd->stats.zero_pfn += last - first;
+}
+
+/*
+ * Pages [@first, @last) of the current window are all present but
+ * excluded from the dump file, so reading them would only fail or
+ * return zeros.
+ */
+static void copy_excluded_run(int first, int last)
+{
+	if (gcd->parallel)
+		gcd->offset += (last - first) * PAGE_SIZE;
+	else if (!gcore_writer_skip(gcore->writer, (last - first) * PAGE_SIZE))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+	gcd->stats.excluded += last - first;
+}
+
+/**
+ * Return the statistics collected since gcore_copy_init().
+ */
+const struct gcore_copy_stats *gcore_copy_get_stats(void)
+{
+	return &gcd->stats;
+}
+
+/**
+ * Print how much coalescing the copy engine achieved in this session.
+ */
+void gcore_copy_report(void)
+{
+	const struct gcore_copy_stats *s = &gcd->stats;
+
+	progressf("Copied %lu pages (%lu present, %lu page-faulted)\n",
+		  s->pages, s->present, s->faulted);
+	progressf("  %lu translations, %lu hitting huge pages\n",
+		  s->translations, s->huge);
+	progressf("  %lu reads, %lu writes, %lu holes; "
+		  "%lu.%02lu pages per read\n", s->reads, s->writes, s->holes,
+		  s->reads ? s->present / s->reads : 0,
+		  s->reads ? (s->present * 100 / s->reads) % 100 : 0);
+	progressf("  %lu zero pages left as holes (%lu mapping the zero "
+		  "page, not read); %llu bytes saved\n",
+		  s->zero + s->zero_pfn, s->zero_pfn,
+		  (ulonglong)(s->zero + s->zero_pfn) * PAGE_SIZE);
+	if (gcd->dedup)
+		progressf("  %lu pages copied from earlier cores, not read\n",
+			  s->dedup);
+	if (gcd->tolerant)
+		progressf("  %lu unreadable pages in %lu ranges left as "
+			  "holes\n", s->bad, gcd->nr_bad);
+	if (gcd->bitmap)
+		progressf("  %lu pages excluded from the dump file left as "
+			  "holes, not read\n", s->excluded);
+}
+
+/*
+ * Look up the page frames of the shared zero page and of the huge
+ * zero page. Anonymous pages that have only been read, and not
+ * written, map one of them.
+ *
+ * zero_pfn has been there since 2.6.32, and huge_zero_pfn since 3.8;
+ * older kernels only have empty_zero_page, and a few releases kept
+ * the huge zero page as a struct page pointer.
+ */
+static void copy_zero_pfn_init(void)
+{
+	physaddr_t paddr;
+	ulong page;
+
+	gcd->zero_pfn = gcd->huge_zero_pfn = ~0UL;
+
+	if (symbol_exists("zero_pfn"))
+		readmem(symbol_value("zero_pfn"), KVADDR, &gcd->zero_pfn,
+			sizeof(ulong), "zero_pfn", RETURN_ON_ERROR|QUIET);
+	else if (symbol_exists("empty_zero_page") &&
+		 kvtop(CURRENT_CONTEXT(), symbol_value("empty_zero_page"),
+		       &paddr, FALSE))
+		gcd->zero_pfn = BTOP(paddr);
+
+	if (symbol_exists("huge_zero_pfn"))
+		readmem(symbol_value("huge_zero_pfn"), KVADDR,
+			&gcd->huge_zero_pfn, sizeof(ulong), "huge_zero_pfn",
+			RETURN_ON_ERROR|QUIET);
+	else if (symbol_exists("huge_zero_page") &&
+		 readmem(symbol_value("huge_zero_page"), KVADDR, &page,
+			 sizeof(ulong), "huge_zero_page",
+			 RETURN_ON_ERROR|QUIET) &&
+		 page && page_to_phys(page, &paddr))
+		gcd->huge_zero_pfn = BTOP(paddr);
+
+	progressf("zero pfn: %lx, huge zero pfn: %lx\n", gcd->zero_pfn,
+		  gcd->huge_zero_pfn);
+}
+
+/*
+ * Whether @vaddr, translated into @paddr by a mapping of @size bytes,
+ * maps the zero page or the huge zero page. The huge zero page can
+ * only be mapped by a huge page translation, whose page frame is that
+ * of the head of the mapping.
+ */
+static int copy_is_zero_pfn(ulong vaddr, physaddr_t paddr, ulong size)
+{
+	if (size > PAGE_SIZE)
+		return gcd->huge_zero_pfn != ~0UL &&
+			BTOP(paddr - (vaddr & (size - 1))) == gcd->huge_zero_pfn;
+
+	return gcd->zero_pfn != ~0UL && BTOP(paddr) == gcd->zero_pfn;
+}
+
+/*
+ * All-zero page detection. The page is OR-ed together in the widest
+ * vector registers available and the loop stops at the first block
+ * with a bit set, so a page with data usually costs a few loads.
+ */
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+static int __attribute__((target("avx2")))
+page_is_zero_avx2(const char *p)
+{
+	int i;
+
+	for (i = 0; i < PAGE_SIZE; i += 128) {
+		__m256i v = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_loadu_si256((const __m256i *)(p + i)),
+				_mm256_loadu_si256((const __m256i *)(p + i + 32))),
+			_mm256_or_si256(
+				_mm256_loadu_si256((const __m256i *)(p + i + 64)),
+				_mm256_loadu_si256((const __m256i *)(p + i + 96))));
+
+		if (!_mm256_testz_si256(v, v))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int page_is_zero_sse2(const char *p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i;
+
+	for (i = 0; i < PAGE_SIZE; i += 64) {
+		__m128i v = _mm_or_si128(
+			_mm_or_si128(
+				_mm_loadu_si128((const __m128i *)(p + i)),
+				_mm_loadu_si128((const __m128i *)(p + i + 16))),
+			_mm_or_si128(
+				_mm_loadu_si128((const __m128i *)(p + i + 32)),
+				_mm_loadu_si128((const __m128i *)(p + i + 48))));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+#elif defined(__aarch64__)
+
+#include <arm_neon.h>
+
+static int page_is_zero_neon(const char *p)
+{
+	int i;
+
+	for (i = 0; i < PAGE_SIZE; i += 64) {
+		uint64x2_t v = vorrq_u64(
+			vorrq_u64(vld1q_u64((const uint64_t *)(p + i)),
+				  vld1q_u64((const uint64_t *)(p + i + 16))),
+			vorrq_u64(vld1q_u64((const uint64_t *)(p + i + 32)),
+				  vld1q_u64((const uint64_t *)(p + i + 48))));
+
+		if (vmaxvq_u32(vreinterpretq_u32_u64(v)))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+#else
+
+static int page_is_zero_generic(const char *p)
+{
+	const ulong *w = (const ulong *)p;
+	int i, n = PAGE_SIZE / sizeof(ulong);
+
+	for (i = 0; i < n; i += 4)
+		if (w[i] | w[i + 1] | w[i + 2] | w[i + 3])
+			return FALSE;
+
+	return TRUE;
+}
+
+#endif
+
+static void copy_zero_page_init(void)
+{
+#if defined(__x86_64__)
+	page_is_zero = __builtin_cpu_supports("avx2") ?
+		page_is_zero_avx2 : page_is_zero_sse2;
+#elif defined(__aarch64__)
+	page_is_zero = page_is_zero_neon;
+#else
+	page_is_zero = page_is_zero_generic;
+#endif
+}
+
+/**
+ * Return TRUE if the page at @page is filled with zeros.
+ *
+ * Precondition:
+ *
+ *   gcore_copy_init() has been called.
+ *
+ * @page need not be aligned. This is called from the copy threads
+ * too, and so must not call into crash.
+ */
+int gcore_page_is_zero(const void *page)
+{
+	return page_is_zero(page);
+}
+
+/*
+ * Architectures providing their own page-table walker override
+ * these weak definitions.
+ */
+int __attribute__((weak))
+gcore_arch_vtop_init(void)
+{
+	return FALSE;
+}
+
+int __attribute__((weak))
+gcore_arch_vtop(ulong vaddr, physaddr_t *paddr, ulong *size)
+{
+	return FALSE;
+}
+
+static int copy_vtop(ulong vaddr, physaddr_t *paddr, ulong *size)
+{
+	gcd->stats.translations++;
+
+	if (gcd->arch_vtop)
+		return gcore_arch_vtop(vaddr, paddr, size);
+
+	*size = PAGE_SIZE;
+	return uvtop_quiet(vaddr, paddr);
+}
+
+static int uvtop_quiet(ulong vaddr, physaddr_t *paddr)
+{
+	FILE *saved_fp = fp;
+	int page_present;
+
+	/* uvtop() with verbose FALSE returns wrong physical address
+	 * for gate_vma. The problem is that kvtop() wrongly thinks of
+	 * the fixed address 0xffffffffff600000 as the one that
+	 * belongs to direct mapping region and calculates the result
+	 * by substracting offset of direct-mapping space from the
+	 * fixed address. However, it's necessary to do paging to get
+	 * correct physical address.
+	 *
+	 * uvtop() does paging if verbose == TRUE. Then, it retuns
+	 * correct physical address.
+	 *
+	 * Next output of vtop clarifies this bug, where the first
+	 * PHYSICAL showing 0x7f600000 is wrong one and the PHYSICAL
+	 * in the last line showing 0x1c08000 is correct one.
+	 *
+	 * crash> vtop 0xffffffffff600000
+	 * VIRTUAL           PHYSICAL
+	 * ffffffffff600000  7f600000
+	 *
+	 * PML4 DIRECTORY: ffffffff81a85000
+	 * PAGE DIRECTORY: 1a87067
+	 *    PUD: 1a87ff8 => 1a88067
+	 *    PMD: 1a88fd8 => 28049067
+	 *    PTE: 28049000 => 1c08165
+	 *   PAGE: 1c08000
+	 *
+	 *   PTE    PHYSICAL  FLAGS
+	 * 1c08165   1c08000  (PRESENT|USER|ACCESSED|DIRTY|GLOBAL)
+	 *
+	 *       PAGE        PHYSICAL      MAPPING       INDEX CNT FLAGS
+	 * ffffea00000621c0   1c08000                0        0  1 20000000000400
+	 *
+	 * The remaining problem is that if specifying TRUE to
+	 * verbose, same information is displayed during gcore
+	 * processing. To avoid this, we assign the file pointer to
+	 * /dev/null to fp during call of uvtop().
+	 */
+	fp = pc->nullfp;
+	page_present = gcore_uvtop(CURRENT_CONTEXT(), vaddr, paddr, TRUE);
+	fp = saved_fp;
+
+	return page_present;
+}
@@ -0,0 +1,761 @@
+/* gcore_copy_parallel.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+#include <elf.h>
+#include <limits.h>
+#include <pthread.h>
+
+/*
+ * Multi-threaded page copy.
+ *
+ * crash's readmem() and everything below it are not reentrant, so
+ * worker threads never call back into crash. Instead, they read the
+ * vmcore file by themselves:
+ *
+ *   - for an ELF vmcore, a physical address is mapped to a file offset
+ *     with the PT_LOAD program headers, and an extent is read with a
+ *     plain pread();
+ *   - for a kdump-compressed vmcore, the pages of an extent are looked
+ *     up in its bitmap and page descriptors, read with pread() and
+ *     decompressed by the worker, see gcore_kdump_read(), so that the
+ *     decompression, the bulk of the copy for such dump files, is
+ *     spread over the workers.
+ *
+ * Each extent is then written with pwrite() into the core file at the
+ * offset the main thread fixed for it. All-zero pages are not written,
+ * so they stay holes in the core file.
+ *
+ * The main thread keeps translating user addresses and laying out the
+ * core file; extents the workers cannot read, outside the file-backed
+ * part of an ELF vmcore or not written into a kdump-compressed one,
+ * are still read with readmem() in the main thread. Other dump
+ * formats, and kdump-compressed ones gcore cannot decompress, are
+ * copied serially.
+ *
+ * The same workers can also read a batch of kernel objects ahead of
+ * note collection, see gcore_parallel_read().
+ */
+
+struct gcore_vmcore_load
+{
+	physaddr_t paddr;
+	ulonglong offset;
+	ulonglong filesz;
+};
+
+struct gcore_parallel_extent
+{
+	ulong vaddr;
+	physaddr_t paddr;
+	off_t dst;
+	size_t len;
+};
+
+struct gcore_parallel_data
+{
+	ulong threads;		/* -j value, 0 or 1 means serial */
+
+	int active;
+	int vmcore_fd;
+	int core_fd;
+	int kdump;		/* read with gcore_kdump_read() */
+	struct gcore_vmcore_load *loads;
+	int nr_loads;
+
+	pthread_t thread[GCORE_PARALLEL_MAX_THREADS];
+	int nr_threads;
+
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	pthread_cond_t idle;
+	struct gcore_parallel_extent queue[GCORE_PARALLEL_QUEUE_SIZE];
+	int head, count;
+	int busy;		/* extents being copied */
+	int shutdown;
+	int error;
+	ulong zero_pages;
+
+	int tolerant;		/* leave unreadable pages as holes */
+	struct gcore_parallel_bad *bad;	/* unreadable pages, malloc()ed */
+	ulong nr_bad;
+	ulong max_bad;
+
+	struct gcore_parallel_read *reads;
+	int nr_reads;
+	int next_read;
+};
+
+static struct gcore_parallel_data gcore_parallel_data;
+static struct gcore_parallel_data *gpd = &gcore_parallel_data;
+
+static int parallel_read_vmcore_loads(void);
+static int parallel_read_vmcore_phnum(void *ehdr, int elf64);
+static void *parallel_worker(void *arg);
+static ssize_t parallel_copy_extent(struct gcore_parallel_extent *e,
+				    char *buf, size_t bufsize, char *scratch);
+static ssize_t parallel_pwrite(char *buf, size_t len, off_t offset);
+static int parallel_vmcore_offset(physaddr_t paddr, ulong len, off_t *src);
+static int parallel_readable(physaddr_t paddr, ulong len);
+static int parallel_pread(physaddr_t paddr, char *buf, size_t len,
+			  char *scratch);
+static char *parallel_alloc_scratch(void);
+static void parallel_add_bad(ulong vaddr, physaddr_t paddr);
+static void *parallel_reader(void *arg);
+
+/**
+ * set the number of copy threads to the default, that is, serial
+ * copy.
+ */
+void gcore_parallel_set_default(void)
+{
+	gpd->threads = 0;
+}
+
+/**
+ * set the number of copy threads
+ *
+ * @threads number of worker threads
+ *
+ * Return Value:
+ *
+ *   If @threads <= GCORE_PARALLEL_MAX_THREADS, return TRUE. Otherwise,
+ *   return FALSE and the state remains the same.
+ */
+int gcore_parallel_set(ulong threads)
+{
+	if (threads > GCORE_PARALLEL_MAX_THREADS)
+		return FALSE;
+	gpd->threads = threads;
+	return TRUE;
+}
+
+ulong gcore_parallel_get(void)
+{
+	return gpd->threads;
+}
+
+/**
+ * Start worker threads that write into @core_fd.
+ *
+ * Return Value:
+ *
+ *   TRUE if the workers are running; FALSE if parallel copy is not
+ *   requested or not possible for the current dump file, in which
+ *   case the caller copies serially.
+ */
+int gcore_parallel_start(int core_fd)
+{
+	int i;
+
+	gpd->active = FALSE;
+	gpd->vmcore_fd = -1;
+
+	if (gpd->threads < 2)
+		return FALSE;
+
+	if (!parallel_read_vmcore_loads()) {
+		progressf("parallel copy is not supported for this dump "
+			  "file format; copying serially.\n");
+		if (gpd->vmcore_fd >= 0)
+			close(gpd->vmcore_fd);
+		gpd->vmcore_fd = -1;
+		return FALSE;
+	}
+
+	gpd->core_fd = core_fd;
+	gpd->head = gpd->count = gpd->busy = 0;
+	gpd->shutdown = FALSE;
+	gpd->error = 0;
+	gpd->zero_pages = 0;
+	gpd->tolerant = gcore_writer_tolerant();
+	free(gpd->bad);
+	gpd->bad = NULL;
+	gpd->nr_bad = gpd->max_bad = 0;
+	pthread_mutex_init(&gpd->lock, NULL);
+	pthread_cond_init(&gpd->not_empty, NULL);
+	pthread_cond_init(&gpd->not_full, NULL);
+	pthread_cond_init(&gpd->idle, NULL);
+
+	for (gpd->nr_threads = 0; gpd->nr_threads < gpd->threads;
+	     gpd->nr_threads++) {
+		if (pthread_create(&gpd->thread[gpd->nr_threads], NULL,
+				   parallel_worker, NULL))
+			break;
+	}
+
+	if (!gpd->nr_threads) {
+		close(gpd->vmcore_fd);
+		gpd->vmcore_fd = -1;
+		return FALSE;
+	}
+
+	gpd->active = TRUE;
+
+	progressf("Copying with %d threads%s\n", gpd->nr_threads,
+		  gpd->kdump ? ", decompressing the dump file" : "");
+
+	for (i = 0; i < gpd->nr_loads; i++)
+		progressf("vmcore PT_LOAD[%d]: paddr %llx "
+			  "offset %llx filesz %llx\n", i,
+			  (ulonglong)gpd->loads[i].paddr,
+			  gpd->loads[i].offset, gpd->loads[i].filesz);
+
+	return TRUE;
+}
+
+/**
+ * Queue a copy of [@paddr, @paddr + @len) in physical memory, mapped at
+ * the user address @vaddr, to the offset @dst of the core file.
+ *
+ * Return Value:
+ *
+ *   TRUE if the extent has been queued. FALSE if the workers are not
+ *   running or cannot read the whole extent from the vmcore file; then
+ *   the caller has to copy it by itself.
+ */
+int gcore_parallel_submit(ulong vaddr, physaddr_t paddr, ulong len,
+			  off_t dst)
+{
+	struct gcore_parallel_extent *e;
+
+	if (!gpd->active)
+		return FALSE;
+
+	if (!parallel_readable(paddr, len))
+		return FALSE;
+
+	pthread_mutex_lock(&gpd->lock);
+	while (gpd->count == GCORE_PARALLEL_QUEUE_SIZE)
+		pthread_cond_wait(&gpd->not_full, &gpd->lock);
+	e = &gpd->queue[(gpd->head + gpd->count) % GCORE_PARALLEL_QUEUE_SIZE];
+	e->vaddr = vaddr;
+	e->paddr = paddr;
+	e->dst = dst;
+	e->len = len;
+	gpd->count++;
+	pthread_cond_signal(&gpd->not_empty);
+	pthread_mutex_unlock(&gpd->lock);
+
+	return TRUE;
+}
+
+/**
+ * Wait for all queued extents to be written, leaving the workers
+ * running.
+ *
+ * Return Value:
+ *
+ *   0 on success, or the errno value of the first failed read or
+ *   write in the workers.
+ */
+int gcore_parallel_drain(void)
+{
+	int err;
+
+	if (!gpd->active)
+		return 0;
+
+	pthread_mutex_lock(&gpd->lock);
+	while (gpd->count || gpd->busy)
+		pthread_cond_wait(&gpd->idle, &gpd->lock);
+	err = gpd->error;
+	pthread_mutex_unlock(&gpd->lock);
+
+	return err;
+}
+
+/**
+ * Wait for all queued extents to be written and stop the workers.
+ *
+ * This is safe to call more than once, and is also called when a
+ * session is aborted.
+ *
+ * Return Value:
+ *
+ *   0 on success, or the errno value of the first failed read or
+ *   write in the workers.
+ */
+int gcore_parallel_finish(void)
+{
+	int i;
+
+	if (!gpd->active)
+		return 0;
+
+	pthread_mutex_lock(&gpd->lock);
+	gpd->shutdown = TRUE;
+	pthread_cond_broadcast(&gpd->not_empty);
+	pthread_mutex_unlock(&gpd->lock);
+
+	for (i = 0; i < gpd->nr_threads; i++)
+		pthread_join(gpd->thread[i], NULL);
+
+	pthread_mutex_destroy(&gpd->lock);
+	pthread_cond_destroy(&gpd->not_empty);
+	pthread_cond_destroy(&gpd->not_full);
+	pthread_cond_destroy(&gpd->idle);
+
+	close(gpd->vmcore_fd);
+	gpd->vmcore_fd = -1;
+	gpd->active = FALSE;
+
+	return gpd->error;
+}
+
+/**
+ * Return how many all-zero pages the workers have left as holes since
+ * gcore_parallel_start().
+ */
+ulong gcore_parallel_zero_pages(void)
+{
+	return gpd->zero_pages;
+}
+
+/**
+ * Return the number of pages the workers could not read and left as
+ * holes with -o tolerant since gcore_parallel_start(), and set *@pages
+ * to their user and physical addresses, in no particular order.
+ */
+ulong gcore_parallel_bad_pages(struct gcore_parallel_bad **pages)
+{
+	*pages = gpd->bad;
+	return gpd->nr_bad;
+}
+
+/**
+ * Read the @nr extents of physical memory described by @reads into
+ * their buffers with the -j number of threads, the calling thread
+ * included. This is meant for the note phase, before the copy workers
+ * are started.
+ *
+ * Return Value:
+ *
+ *   TRUE if the extents have been read in parallel; then the done
+ *   field of each tells whether it could be read. FALSE if parallel
+ *   reads are not requested or not possible for the current dump file,
+ *   in which case nothing has been read.
+ */
+int gcore_parallel_read(struct gcore_parallel_read *reads, int nr)
+{
+	pthread_t thread[GCORE_PARALLEL_MAX_THREADS];
+	int i, nr_threads;
+
+	if (gpd->threads < 2 || gpd->active || nr <= 0)
+		return FALSE;
+
+	gpd->vmcore_fd = -1;
+
+	if (!parallel_read_vmcore_loads()) {
+		if (gpd->vmcore_fd >= 0)
+			close(gpd->vmcore_fd);
+		gpd->vmcore_fd = -1;
+		return FALSE;
+	}
+
+	for (i = 0; i < nr; i++)
+		reads[i].done = FALSE;
+
+	gpd->reads = reads;
+	gpd->nr_reads = nr;
+	gpd->next_read = 0;
+
+	for (nr_threads = 0; nr_threads < MIN(gpd->threads - 1, nr - 1);
+	     nr_threads++) {
+		if (pthread_create(&thread[nr_threads], NULL,
+				   parallel_reader, NULL))
+			break;
+	}
+
+	parallel_reader(NULL);
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(thread[i], NULL);
+
+	close(gpd->vmcore_fd);
+	gpd->vmcore_fd = -1;
+	gpd->reads = NULL;
+
+	return TRUE;
+}
+
+/*
+ * Take extents of gpd->reads one at a time until none is left.
+ */
+static void *parallel_reader(void *arg)
+{
+	char *scratch = NULL;
+	int i;
+
+	if (gpd->kdump && !(scratch = parallel_alloc_scratch()))
+		return NULL;
+
+	while ((i = __atomic_fetch_add(&gpd->next_read, 1, __ATOMIC_RELAXED))
+	       < gpd->nr_reads) {
+		struct gcore_parallel_read *r = &gpd->reads[i];
+
+		r->done = parallel_readable(r->paddr, r->len) &&
+			parallel_pread(r->paddr, r->buf, r->len, scratch) == 0;
+	}
+
+	free(scratch);
+	return NULL;
+}
+
+/*
+ * Return TRUE if the workers can read [@paddr, @paddr + @len) from the
+ * vmcore file by themselves.
+ */
+static int parallel_readable(physaddr_t paddr, ulong len)
+{
+	off_t src;
+
+	if (gpd->kdump)
+		return gcore_kdump_readable(paddr, len);
+
+	return parallel_vmcore_offset(paddr, len, &src);
+}
+
+/*
+ * Read [@paddr, @paddr + @len) from the vmcore file into @buf, with the
+ * @scratch buffer of the calling thread for a kdump-compressed vmcore.
+ * Return 0 on success, or -1 with errno set.
+ */
+static int parallel_pread(physaddr_t paddr, char *buf, size_t len,
+			  char *scratch)
+{
+	off_t src;
+	size_t n;
+
+	if (gpd->kdump)
+		return gcore_kdump_read(gpd->vmcore_fd, paddr, buf, len,
+					scratch);
+
+	if (!parallel_vmcore_offset(paddr, len, &src)) {
+		errno = EIO;
+		return -1;
+	}
+
+	for (n = 0; n < len;) {
+		ssize_t r = pread(gpd->vmcore_fd, buf + n, len - n, src + n);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0) {
+			if (!r)
+				errno = EIO;
+			return -1;
+		}
+		n += r;
+	}
+
+	return 0;
+}
+
+/*
+ * Allocate the buffer a thread needs to decompress pages of a
+ * kdump-compressed vmcore, or return NULL.
+ */
+static char *parallel_alloc_scratch(void)
+{
+	return malloc(gcore_kdump_scratch_size());
+}
+
+/*
+ * Map [@paddr, @paddr + @len) to an offset of the vmcore file. This
+ * fails if the range is not entirely backed by one PT_LOAD segment.
+ */
+static int parallel_vmcore_offset(physaddr_t paddr, ulong len, off_t *src)
+{
+	int i;
+
+	for (i = 0; i < gpd->nr_loads; i++) {
+		struct gcore_vmcore_load *load = &gpd->loads[i];
+
+		if (load->paddr <= paddr &&
+		    paddr + len <= load->paddr + load->filesz) {
+			*src = load->offset + (paddr - load->paddr);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void *parallel_worker(void *arg)
+{
+	size_t bufsize = GCORE_COPY_BATCH_PAGES * PAGE_SIZE;
+	char *buf, *scratch = NULL;
+
+	if (!(buf = malloc(bufsize)) ||
+	    (gpd->kdump && !(scratch = parallel_alloc_scratch()))) {
+		free(buf);
+		buf = NULL;
+		pthread_mutex_lock(&gpd->lock);
+		if (!gpd->error)
+			gpd->error = ENOMEM;
+		pthread_mutex_unlock(&gpd->lock);
+	}
+
+	for (;;) {
+		struct gcore_parallel_extent e;
+
+		pthread_mutex_lock(&gpd->lock);
+		while (!gpd->count && !gpd->shutdown)
+			pthread_cond_wait(&gpd->not_empty, &gpd->lock);
+		if (!gpd->count) {
+			pthread_mutex_unlock(&gpd->lock);
+			break;
+		}
+		e = gpd->queue[gpd->head];
+		gpd->head = (gpd->head + 1) % GCORE_PARALLEL_QUEUE_SIZE;
+		gpd->count--;
+		gpd->busy++;
+		pthread_cond_signal(&gpd->not_full);
+		pthread_mutex_unlock(&gpd->lock);
+
+		/*
+		 * Once an error happened, keep draining the queue so
+		 * that the main thread never blocks on it.
+		 */
+		if (buf && !gpd->error &&
+		    parallel_copy_extent(&e, buf, bufsize, scratch) < 0) {
+			int err = errno ? errno : EIO;
+
+			pthread_mutex_lock(&gpd->lock);
+			if (!gpd->error)
+				gpd->error = err;
+			pthread_mutex_unlock(&gpd->lock);
+		}
+
+		pthread_mutex_lock(&gpd->lock);
+		if (!--gpd->busy && !gpd->count)
+			pthread_cond_broadcast(&gpd->idle);
+		pthread_mutex_unlock(&gpd->lock);
+	}
+
+	free(scratch);
+	free(buf);
+	return NULL;
+}
+
+static ssize_t parallel_copy_extent(struct gcore_parallel_extent *e,
+				    char *buf, size_t bufsize, char *scratch)
+{
+	size_t done = 0;
+
+	while (done < e->len) {
+		size_t chunk = MIN(bufsize, e->len - done);
+		size_t n, m;
+
+		/* As copy_read(), page by page with -o tolerant. */
+		if (parallel_pread(e->paddr + done, buf, chunk, scratch) < 0) {
+			if (!gpd->tolerant)
+				return -1;
+			for (n = 0; n < chunk; n += PAGE_SIZE) {
+				if (parallel_pread(e->paddr + done + n,
+						   buf + n, PAGE_SIZE,
+						   scratch) == 0)
+					continue;
+				memset(buf + n, 0, PAGE_SIZE);
+				parallel_add_bad(e->vaddr + done + n,
+						 e->paddr + done + n);
+			}
+		}
+
+		for (n = 0; n < chunk; n = m) {
+			int zero = gcore_page_is_zero(buf + n);
+
+			for (m = n + PAGE_SIZE; m < chunk; m += PAGE_SIZE)
+				if (gcore_page_is_zero(buf + m) != zero)
+					break;
+
+			if (zero)
+				__atomic_fetch_add(&gpd->zero_pages,
+						   (m - n) / PAGE_SIZE,
+						   __ATOMIC_RELAXED);
+			else if (parallel_pwrite(buf + n, m - n,
+						 e->dst + done + n) < 0)
+				return -1;
+		}
+
+		done += chunk;
+	}
+
+	return done;
+}
+
+/*
+ * Record the unreadable page at @vaddr, @paddr. With no memory left for
+ * it, the copy fails as without -o tolerant.
+ */
+static void parallel_add_bad(ulong vaddr, physaddr_t paddr)
+{
+	pthread_mutex_lock(&gpd->lock);
+
+	if (gpd->nr_bad == gpd->max_bad) {
+		ulong max = gpd->max_bad ? 2 * gpd->max_bad : 64;
+		struct gcore_parallel_bad *bad =
+			realloc(gpd->bad, max * sizeof(*bad));
+
+		if (!bad) {
+			if (!gpd->error)
+				gpd->error = ENOMEM;
+			pthread_mutex_unlock(&gpd->lock);
+			return;
+		}
+		gpd->bad = bad;
+		gpd->max_bad = max;
+	}
+
+	gpd->bad[gpd->nr_bad].vaddr = vaddr;
+	gpd->bad[gpd->nr_bad].paddr = paddr;
+	gpd->nr_bad++;
+
+	pthread_mutex_unlock(&gpd->lock);
+}
+
+static ssize_t parallel_pwrite(char *buf, size_t len, off_t offset)
+{
+	size_t n;
+
+	for (n = 0; n < len;) {
+		ssize_t w = pwrite(gpd->core_fd, buf + n, len - n, offset + n);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0)
+			return -1;
+		n += w;
+	}
+
+	return n;
+}
+
+/*
+ * Open pc->dumpfile and, if it is an ELF vmcore, collect its PT_LOAD
+ * program headers, or if it is a kdump-compressed vmcore, check that
+ * gcore_kdump_read() can read it. Segments are GETBUF()ed, so they
+ * only live during one session.
+ */
+static int parallel_read_vmcore_loads(void)
+{
+	unsigned char ident[EI_NIDENT];
+	int i, phnum;
+
+	gpd->nr_loads = 0;
+	gpd->kdump = FALSE;
+
+	if (!pc->dumpfile)
+		return FALSE;
+
+	if ((gpd->vmcore_fd = open(pc->dumpfile, O_RDONLY)) < 0)
+		return FALSE;
+
+	if (gcore_kdump_active()) {
+		gpd->kdump = TRUE;
+		return TRUE;
+	}
+
+	if (pread(gpd->vmcore_fd, ident, sizeof(ident), 0) != sizeof(ident)
+	    || memcmp(ident, ELFMAG, SELFMAG) != 0)
+		return FALSE;
+
+	if (ident[EI_CLASS] == ELFCLASS64) {
+		Elf64_Ehdr ehdr;
+		Elf64_Phdr phdr;
+
+		if (pread(gpd->vmcore_fd, &ehdr, sizeof(ehdr), 0)
+		    != sizeof(ehdr) || ehdr.e_type != ET_CORE)
+			return FALSE;
+
+		if ((phnum = parallel_read_vmcore_phnum(&ehdr, TRUE)) < 0)
+			return FALSE;
+		gpd->loads = (struct gcore_vmcore_load *)
+			GETBUF(phnum * sizeof(struct gcore_vmcore_load));
+
+		for (i = 0; i < phnum; i++) {
+			if (pread(gpd->vmcore_fd, &phdr, sizeof(phdr),
+				  ehdr.e_phoff + (off_t)i * ehdr.e_phentsize)
+			    != sizeof(phdr))
+				return FALSE;
+			if (phdr.p_type != PT_LOAD || !phdr.p_filesz)
+				continue;
+			gpd->loads[gpd->nr_loads].paddr = phdr.p_paddr;
+			gpd->loads[gpd->nr_loads].offset = phdr.p_offset;
+			gpd->loads[gpd->nr_loads].filesz = phdr.p_filesz;
+			gpd->nr_loads++;
+		}
+	} else if (ident[EI_CLASS] == ELFCLASS32) {
+		Elf32_Ehdr ehdr;
+		Elf32_Phdr phdr;
+
+		if (pread(gpd->vmcore_fd, &ehdr, sizeof(ehdr), 0)
+		    != sizeof(ehdr) || ehdr.e_type != ET_CORE)
+			return FALSE;
+
+		if ((phnum = parallel_read_vmcore_phnum(&ehdr, FALSE)) < 0)
+			return FALSE;
+		gpd->loads = (struct gcore_vmcore_load *)
+			GETBUF(phnum * sizeof(struct gcore_vmcore_load));
+
+		for (i = 0; i < phnum; i++) {
+			if (pread(gpd->vmcore_fd, &phdr, sizeof(phdr),
+				  ehdr.e_phoff + (off_t)i * ehdr.e_phentsize)
+			    != sizeof(phdr))
+				return FALSE;
+			if (phdr.p_type != PT_LOAD || !phdr.p_filesz)
+				continue;
+			gpd->loads[gpd->nr_loads].paddr = phdr.p_paddr;
+			gpd->loads[gpd->nr_loads].offset = phdr.p_offset;
+			gpd->loads[gpd->nr_loads].filesz = phdr.p_filesz;
+			gpd->nr_loads++;
+		}
+	} else
+		return FALSE;
+
+	return gpd->nr_loads > 0;
+}
+
+/*
+ * Return the number of program headers of the vmcore whose ELF header
+ * is @ehdr, or -1 if it cannot be found. With more than PN_XNUM - 1 of
+ * them, e_phnum is PN_XNUM and the number is in sh_info of section
+ * header 0.
+ */
+static int parallel_read_vmcore_phnum(void *ehdr, int elf64)
+{
+	if (elf64) {
+		Elf64_Ehdr *e = ehdr;
+		Elf64_Shdr shdr;
+
+		if (e->e_phnum != PN_XNUM)
+			return e->e_phnum;
+		if (!e->e_shoff || pread(gpd->vmcore_fd, &shdr, sizeof(shdr),
+					 e->e_shoff) != sizeof(shdr))
+			return -1;
+		return shdr.sh_info > INT_MAX ? -1 : (int)shdr.sh_info;
+	} else {
+		Elf32_Ehdr *e = ehdr;
+		Elf32_Shdr shdr;
+
+		if (e->e_phnum != PN_XNUM)
+			return e->e_phnum;
+		if (!e->e_shoff || pread(gpd->vmcore_fd, &shdr, sizeof(shdr),
+					 e->e_shoff) != sizeof(shdr))
+			return -1;
+		return shdr.sh_info > INT_MAX ? -1 : (int)shdr.sh_info;
+	}
+}
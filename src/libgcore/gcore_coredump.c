@@ -47,101 +47,128 @@ static int compat_fill_files_note(struct elf_note_info *info,
 #endif
 
 static void fill_elf_header(int phnum);
-static void fill_write_thread_core_info(FILE *fp, struct task_context *tc,
+static void prefetch_thread_group(struct task_context *dump_tc);
+static void fill_write_thread_core_info(struct gcore_writer *writer,
+					struct task_context *tc,
 					struct task_context *dump_tc,
 					struct elf_note_info *info,
 					const struct user_regset_view *view,
 					loff_t *offset, size_t *total);
-static int fill_write_note_info(FILE *fp, struct elf_note_info *info, int phnum,
+static int fill_write_note_info(struct gcore_writer *writer,
+				struct elf_note_info *info, int phnum,
 				loff_t *offset);
 static void fill_note(struct memelfnote *note, const char *name, int type,
 		      unsigned int sz, void *data);
 
 static int notesize(struct memelfnote *en);
-static void alignfile(FILE *fp, loff_t *foffset);
-static void writenote(struct memelfnote *men, FILE *fp, loff_t *foffset);
+static void alignfile(struct gcore_writer *writer, loff_t *foffset);
+static void writenote(struct memelfnote *men, struct gcore_writer *writer,
+		      loff_t *foffset);
 static size_t get_note_info_size(struct elf_note_info *info);
+static void fill_file_pathname(ulong file, char *buf);
 
 static inline int thread_group_leader(ulong task);
 
-static int uvtop_quiet(ulong vaddr, physaddr_t *paddr);
+static void write_bad_ranges_note(off_t phdr);
+
+static void fill_vma_table(ulong mmap, ulong gate_vma, int map_count);
+static void fill_segments(void);
+static void add_segment(ulong vaddr, ulong filesz, ulong memsz,
+			uint32_t flags);
 
 void gcore_coredump(void)
 {
 	struct elf_note_info *info;
 	int map_count, phnum;
-	ulong vma, index, mmap;
+	ulong index, mm, mmap;
+	ulong resume_index, resume_vaddr;
+	off_t bad_phdr = -1;
 	loff_t offset;
-	char *mm_cache, *buffer = NULL;
+	char *mm_cache;
 	ulong gate_vma;
 
 	gcore->flags |= GCF_UNDER_COREDUMP;
 
-	mm_cache = fill_mm_struct(task_mm(CURRENT_TASK(), TRUE));
+	gcore_objcache_init();
+	gcore_stats_init();
+
+	gcore_phase_begin(GCORE_PHASE_VMAS);
+	mm = task_mm(CURRENT_TASK(), TRUE);
+	mm_cache = fill_mm_struct(mm);
 	if (!mm_cache)
 		error(FATAL, "The user memory space does not exist.\n");
 
-	mmap = ULONG(mm_cache + OFFSET(mm_struct_mmap));
+	mmap = gcore_mm_vmas(mm, mm_cache);
 	map_count = INT(mm_cache + GCORE_OFFSET(mm_struct_map_count));
 
-	phnum = map_count;
-	phnum++; /* for note information */
 	gate_vma = gcore_arch_get_gate_vma();
-	if (gate_vma)
-		phnum++;
+
+	fill_vma_table(mmap, gate_vma, map_count);
+	fill_segments();
+	gcore_phase_end(GCORE_PHASE_VMAS);
+
+	phnum = gcore->nr_segments;
+	phnum++; /* for note information */
+	if (gcore_writer_tolerant())
+		phnum++; /* for the bad ranges note */
 
 	info = elf_note_info_init();
 
 	fill_elf_header(phnum);
 
 	progressf("Opening file %s ... \n", gcore->corename);
-	gcore->fp = fopen(gcore->corename, "w");
-	if (!gcore->fp)
+	gcore_phase_begin(GCORE_PHASE_OPEN);
+	gcore_journal_open(gcore->corename);
+	gcore->writer = gcore_writer_open(gcore->corename);
+	if (!gcore->writer)
 		error(FATAL, "%s: open: %s\n", gcore->corename,
 		      strerror(errno));
+	gcore_phase_end(GCORE_PHASE_OPEN);
 	progressf("done.\n");
 
 	progressf("Writing ELF header ... \n");
-	if (!gcore->elf->ops->write_elf_header(gcore->elf, gcore->fp))
+	gcore_phase_begin(GCORE_PHASE_ELF_HEADER);
+	if (!gcore->elf->ops->write_elf_header(gcore->elf, gcore->writer))
 		error(FATAL, "%s: write: %s\n", gcore->corename,
 		      strerror(errno));
+	gcore_phase_end(GCORE_PHASE_ELF_HEADER);
 	progressf(" done.\n");
 
 	offset = gcore->elf->ops->calc_segment_offset(gcore->elf);
 
-	if (fseek(gcore->fp, offset, SEEK_SET) < 0) {
-		error(FATAL, "%s: fseek: %s\n", gcore->corename,
+	if (!gcore_writer_seek(gcore->writer, offset)) {
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
 		      strerror(errno));
 	}
 
 	progressf("Retrieving and writing note information ... \n");
-	fill_write_note_info(gcore->fp, info, phnum, &offset);
+	gcore_phase_begin(GCORE_PHASE_NOTES);
+	fill_write_note_info(gcore->writer, info, phnum, &offset);
+	gcore_phase_end(GCORE_PHASE_NOTES);
+	gcore_objcache_report();
 	progressf("done.\n");
 
+	gcore_phase_begin(GCORE_PHASE_PHDRS);
+
 	if (gcore->elf->ops->get_e_shoff(gcore->elf)) {
-		if (fseek(gcore->fp, gcore->elf->ops->get_e_shoff(gcore->elf),
-			  SEEK_SET) < 0) {
-			error(FATAL, "%s: fseek: %s\n", gcore->corename,
-			      strerror(errno));
-		}
 		progressf("Writing section header table ... \n");
 		if (!gcore->elf->ops->write_section_header(gcore->elf,
-							   gcore->fp))
+							   gcore->writer))
 			error(FATAL, "%s: gcore: %s\n", gcore->corename,
 			      strerror(errno));
 		progressf("done.\n");
 	}
 
 	progressf("Writing PT_NOTE program header ... \n");
-	if (fseek(gcore->fp, gcore->elf->ops->get_e_phoff(gcore->elf),
-		  SEEK_SET) < 0) {
-		error(FATAL, "%s: fseek: %s\n", gcore->corename,
+	if (!gcore_writer_seek(gcore->writer,
+			       gcore->elf->ops->get_e_phoff(gcore->elf))) {
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
 		      strerror(errno));
 	}
 	offset = gcore->elf->ops->calc_segment_offset(gcore->elf);
 	gcore->elf->ops->fill_program_header(gcore->elf, PT_NOTE, 0, offset, 0,
 					     get_note_info_size(info), 0, 0);
-	if (!gcore->elf->ops->write_program_header(gcore->elf, gcore->fp))
+	if (!gcore->elf->ops->write_program_header(gcore->elf, gcore->writer))
 		error(FATAL, "%s: write: %s\n", gcore->corename,
 		      strerror(errno));
 	progressf("done.\n");
@@ -152,41 +179,38 @@ void gcore_coredump(void)
 	offset = roundup(offset, ELF_EXEC_PAGESIZE);
 
 	progressf("Writing PT_LOAD program headers ... \n");
-	FOR_EACH_VMA_OBJECT(vma, index, mmap, gate_vma) {
-		char *vma_cache;
-		ulong vm_start, vm_end, vm_flags;
-		uint64_t p_offset, p_filesz;
-		uint32_t p_flags;
-
-		vma_cache = fill_vma_cache(vma);
-		vm_start = ULONG(vma_cache + OFFSET(vm_area_struct_vm_start));
-		vm_end   = ULONG(vma_cache + OFFSET(vm_area_struct_vm_end));
-		vm_flags = ULONG(vma_cache + OFFSET(vm_area_struct_vm_flags));
-
-		p_flags = 0;
-		if (vm_flags & VM_READ)
-			p_flags |= PF_R;
-		if (vm_flags & VM_WRITE)
-			p_flags |= PF_W;
-		if (vm_flags & VM_EXEC)
-			p_flags |= PF_X;
-
-		p_offset = offset;
-		p_filesz = gcore_dumpfilter_vma_dump_size(vma);
-
-		offset += p_filesz;
+	for (index = 0; index < gcore->nr_segments; index++) {
+		struct gcore_segment *seg = &gcore->segments[index];
 
 		gcore->elf->ops->fill_program_header(gcore->elf, PT_LOAD,
-						     p_flags, p_offset,
-						     vm_start, p_filesz,
-						     vm_end - vm_start,
+						     seg->flags, offset,
+						     seg->vaddr, seg->filesz,
+						     seg->memsz,
 						     ELF_EXEC_PAGESIZE);
 
+		seg->offset = offset;
+		offset += seg->filesz;
+
+		if (!gcore->elf->ops->write_program_header(gcore->elf,
+							   gcore->writer))
+			error(FATAL, "%s: write, %s\n", gcore->corename,
+			      strerror(errno));
+	}
+
+	/*
+	 * With -o tolerant, the bad ranges note goes after the data; its
+	 * program header is filled in once the data has been copied.
+	 */
+	if (gcore_writer_tolerant()) {
+		bad_phdr = gcore_writer_tell(gcore->writer);
+		gcore->elf->ops->fill_program_header(gcore->elf, PT_NOTE, 0,
+						     offset, 0, 0, 0, 0);
 		if (!gcore->elf->ops->write_program_header(gcore->elf,
-							   gcore->fp))
+							   gcore->writer))
 			error(FATAL, "%s: write, %s\n", gcore->corename,
 			      strerror(errno));
 	}
+	gcore_phase_end(GCORE_PHASE_PHDRS);
 	progressf("done.\n");
 
 	/* Align to page. Segment needs to begin with offset multiple
@@ -198,85 +222,250 @@ void gcore_coredump(void)
 		+ get_note_info_size(info);
 	offset = roundup(offset, ELF_EXEC_PAGESIZE);
 
-	if (fseek(gcore->fp, offset, SEEK_SET) < 0) {
-		error(FATAL, "%s: fseek: %s\n", gcore->corename,
+	if (!gcore_writer_seek(gcore->writer, offset)) {
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
 		      strerror(errno));
 	}
 
-	buffer = GETBUF(PAGE_SIZE);
-	BZERO(buffer, PAGE_SIZE);
+	gcore_phase_begin(GCORE_PHASE_COPY);
+
+	gcore_journal_begin_data(gcore->writer, offset, &resume_index,
+				 &resume_vaddr);
+
+	if (!gcore_writer_begin_data(gcore->writer))
+		error(FATAL, "%s: write: %s\n", gcore->corename,
+		      strerror(errno));
+
+	gcore_copy_init();
 
 	progressf("Writing PT_LOAD segment ... \n");
-	FOR_EACH_VMA_OBJECT(vma, index, mmap, gate_vma) {
-		ulong addr, end, vm_start;
-
-		vm_start = ULONG(fill_vma_cache(vma) +
-				 OFFSET(vm_area_struct_vm_start));
-
-		end = vm_start + gcore_dumpfilter_vma_dump_size(vma);
-
-		progressf("PT_LOAD[%lu]: %lx - %lx\n", index, vm_start, end);
-
-		for (addr = vm_start; addr < end; addr += PAGE_SIZE) {
-			physaddr_t paddr;
-
-			if (uvtop_quiet(addr, &paddr)) {
-				readmem(paddr, PHYSADDR, buffer, PAGE_SIZE,
-					"readmem vma list",
-					gcore_verbose_error_handle());
-				if (fwrite(buffer, PAGE_SIZE, 1, gcore->fp)
-				    != 1)
-					error(FATAL, "%s: write: %s\n",
-					      gcore->corename,
-					      strerror(errno));
-			} else {
-				pagefaultf("page fault at %lx\n", addr);
-
-				/* Fill unavailable page-faulted pages
-				 * with 0 for ease of implementation;
-				 * to be honest, I want to avoid
-				 * restructuring program header table.
-				 *
-				 * Also, we do skip these pages by
-				 * fseek(). Recent filesystems support
-				 * sparse file that doesn't allocate
-				 * actual blocks if there are no
-				 * corresponding write; such part is
-				 * called hole. Hence, the skip works
-				 * just like a filter for page-faulted
-				 * pages.
-				 *
-				 * Note, however, that we don't reedit
-				 * program headers and these pages are
-				 * logically present on corefile as
-				 * zero-filled pages. If copying the
-				 * corefile on system that doesn't
-				 * support sparse file, resulting
-				 * corefile can be much larger than
-				 * original size.
-				 */
-				if (fseek(gcore->fp, PAGE_SIZE, SEEK_CUR) < 0) {
-					error(FATAL, "%s: fseek: %s\n",
-					      gcore->corename,
-					      strerror(errno));
-				}
-			}
+	for (index = 0; index < gcore->nr_segments; index++) {
+		struct gcore_segment *seg = &gcore->segments[index];
+		ulong addr, next, end = seg->vaddr + seg->filesz;
+
+		/* Data copied by an earlier run, with -o resume. */
+		addr = seg->vaddr;
+		if (index < resume_index)
+			addr = end;
+		else if (index == resume_index)
+			addr = resume_vaddr;
+		if (addr > seg->vaddr) {
+			gcore_copy_skip(addr - seg->vaddr);
+			if (addr == end)
+				continue;
+		}
+
+		progressf("PT_LOAD[%lu]: %lx - %lx\n", index, addr, end);
+
+		for (; addr < end; addr = next) {
+			next = end;
+			if (gcore_journal_active() &&
+			    end - addr > GCORE_JOURNAL_INTERVAL)
+				next = addr + GCORE_JOURNAL_INTERVAL;
+			gcore_copy_range(addr, next);
+			gcore_journal_checkpoint(index, next);
 		}
 	}
+	gcore_copy_finish();
+	gcore_pagefault_report();
+	if (bad_phdr >= 0)
+		write_bad_ranges_note(bad_phdr);
+	if (!gcore_writer_flush(gcore->writer))
+		error(FATAL, "%s: write: %s\n", gcore->corename,
+		      strerror(errno));
+	gcore_phase_end(GCORE_PHASE_COPY);
+	gcore_copy_report();
+	gcore_writer_report(gcore->writer);
 	progressf("done.\n");
 
+	gcore_stats_report();
+
 	gcore->flags |= GCF_SUCCESS;
 
 }
 
+/*
+ * Walk the VMA list once, gate_vma included, and record what the later
+ * phases need of each VMA, dump size included, in gcore->vmas.
+ */
+static void fill_vma_table(ulong mmap, ulong gate_vma, int map_count)
+{
+	ulong vma, index, max;
+
+	max = map_count + 1;
+	gcore->vmas = (struct gcore_vma *)
+		GETBUF(max * sizeof(struct gcore_vma));
+
+	FOR_EACH_VMA_OBJECT(vma, index, mmap, gate_vma) {
+		struct gcore_vma *v;
+		char *vma_cache;
+
+		/* map_count is only a hint; grow the table by half. */
+		if (index == max) {
+			max += max / 2 + 1;
+			v = (struct gcore_vma *)GETBUF(max * sizeof(*v));
+			memcpy(v, gcore->vmas, index * sizeof(*v));
+			FREEBUF(gcore->vmas);
+			gcore->vmas = v;
+		}
+
+		v = &gcore->vmas[index];
+
+		vma_cache = fill_vma_cache(vma);
+		v->vma = vma;
+		v->start = ULONG(vma_cache + OFFSET(vm_area_struct_vm_start));
+		v->end = ULONG(vma_cache + OFFSET(vm_area_struct_vm_end));
+		v->flags = ULONG(vma_cache + OFFSET(vm_area_struct_vm_flags));
+		v->file = ULONG(vma_cache + OFFSET(vm_area_struct_vm_file));
+		v->pgoff = ULONG(vma_cache + OFFSET(vm_area_struct_vm_pgoff));
+
+		v->p_flags = 0;
+		if (v->flags & VM_READ)
+			v->p_flags |= PF_R;
+		if (v->flags & VM_WRITE)
+			v->p_flags |= PF_W;
+		if (v->flags & VM_EXEC)
+			v->p_flags |= PF_X;
+
+		v->dump_size = gcore_dumpfilter_vma_dump_size(vma);
+	}
+
+	gcore->nr_vmas = index;
+}
+
+/*
+ * Lay out the PT_LOAD segments, one per VMA, gate_vma included.
+ *
+ * With -o trim, the part of each VMA to be dumped is scanned for
+ * present pages first. Page-faulted pages at its end are left out of
+ * p_filesz, and the VMA is split at each page-faulted gap of at least
+ * the trim gap, so that the gap lies beyond the p_filesz of the
+ * segment before it and takes no room in the core file.
+ *
+ * If the dump file tells which pages it excludes, pages excluded from
+ * it count as page-faulted, and the bytes each VMA can be recovered
+ * from it are reported with progress messages.
+ */
+static void fill_segments(void)
+{
+	ulong index, gap, dumped, kept, recoverable;
+	int report;
+
+	gcore->max_segments = gcore->nr_vmas;
+	gcore->segments = (struct gcore_segment *)
+		GETBUF(gcore->max_segments * sizeof(struct gcore_segment));
+	gcore->nr_segments = 0;
+
+	gap = gcore_writer_trim_gap();
+	report = (gcore_verbose_get() & VERBOSE_PROGRESS) &&
+		gcore_bitmap_active();
+	if (gap || report)
+		gcore_copy_scan_init();
+
+	dumped = kept = recoverable = 0;
+
+	for (index = 0; index < gcore->nr_vmas; index++) {
+		struct gcore_vma *v = &gcore->vmas[index];
+		ulong vm_start = v->start, vm_end = v->end;
+		ulong dump_end, start, end;
+		uint32_t p_flags = v->p_flags;
+
+		dump_end = vm_start + v->dump_size;
+		dumped += dump_end - vm_start;
+
+		if (report) {
+			ulong bytes;
+
+			bytes = gcore_copy_recoverable(vm_start, dump_end);
+			progressf("VMA %lx - %lx: %lu of %lu bytes to dump "
+				  "recoverable\n", vm_start, vm_end, bytes,
+				  dump_end - vm_start);
+			recoverable += bytes;
+		}
+
+		if (!gap) {
+			add_segment(vm_start, dump_end - vm_start,
+				    vm_end - vm_start, p_flags);
+			continue;
+		}
+
+		/*
+		 * Each segment covers [start, end) in the file, and in
+		 * memory up to the start of the next one, or up to the
+		 * end of the VMA for the last one.
+		 */
+		start = vm_start;
+		end = gcore_copy_scan(vm_start, dump_end, TRUE);
+		if (end == dump_end) {
+			add_segment(vm_start, 0, vm_end - vm_start, p_flags);
+			continue;
+		}
+		if (end - start >= gap) {
+			add_segment(start, 0, end - start, p_flags);
+			start = end;
+		}
+
+		for (;;) {
+			ulong next;
+
+			end = gcore_copy_scan(end, dump_end, FALSE);
+			next = gcore_copy_scan(end, dump_end, TRUE);
+			if (next == dump_end)
+				break;
+			if (next - end >= gap) {
+				add_segment(start, end - start, next - start,
+					    p_flags);
+				kept += end - start;
+				start = next;
+			}
+			end = next;
+		}
+
+		add_segment(start, end - start, vm_end - start, p_flags);
+		kept += end - start;
+	}
+
+	if (gap)
+		progressf("Kept %lu of %lu bytes to dump, in %lu segments "
+			  "for %lu VMAs\n", kept, dumped, gcore->nr_segments,
+			  gcore->nr_vmas);
+	if (report)
+		progressf("Recoverable %lu of %lu bytes to dump from the "
+			  "dump file\n", recoverable, dumped);
+}
+
+static void add_segment(ulong vaddr, ulong filesz, ulong memsz,
+			uint32_t flags)
+{
+	struct gcore_segment *seg;
+
+	/* The table is sized for one segment per VMA; grow it by half. */
+	if (gcore->nr_segments == gcore->max_segments) {
+		ulong max = gcore->max_segments + gcore->max_segments / 2 + 1;
+
+		seg = (struct gcore_segment *)GETBUF(max * sizeof(*seg));
+		memcpy(seg, gcore->segments,
+		       gcore->nr_segments * sizeof(*seg));
+		FREEBUF(gcore->segments);
+		gcore->segments = seg;
+		gcore->max_segments = max;
+	}
+
+	seg = &gcore->segments[gcore->nr_segments++];
+	seg->vaddr = vaddr;
+	seg->filesz = filesz;
+	seg->memsz = memsz;
+	seg->flags = flags;
+}
+
 static inline int
 thread_group_leader(ulong task)
 {
 	ulong group_leader;
 
-	readmem(task + GCORE_OFFSET(task_struct_group_leader), KVADDR,
-		&group_leader, sizeof(group_leader),
-		"thread_group_leader: group_leader",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		GCORE_OFFSET(task_struct_group_leader), &group_leader,
+		sizeof(group_leader), "thread_group_leader: group_leader",
 		gcore_verbose_error_handle());
 
 	return task == group_leader;
@@ -287,8 +476,9 @@ task_nice(ulong task)
 {
 	int static_prio;
 
-	readmem(task + GCORE_OFFSET(task_struct_static_prio), KVADDR,
-		&static_prio, sizeof(static_prio), "task_nice: static_prio",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		GCORE_OFFSET(task_struct_static_prio), &static_prio,
+		sizeof(static_prio), "task_nice: static_prio",
 		gcore_verbose_error_handle());
 
 	return PRIO_TO_NICE(static_prio);
@@ -331,16 +521,17 @@ fill_psinfo_note(struct elf_note_info *info, struct task_context *tc,
                         psinfo->pr_psargs[i] = ' ';
         psinfo->pr_psargs[len] = 0;
 
-	readmem(tc->task + GCORE_OFFSET(task_struct_real_parent), KVADDR,
-		&parent, sizeof(parent), "fill_psinfo: real_parent",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		GCORE_OFFSET(task_struct_real_parent), &parent, sizeof(parent),
+		"fill_psinfo: real_parent", gcore_verbose_error_handle());
 
 	psinfo->pr_ppid = ggt->task_pid(parent);
 	psinfo->pr_pid = ggt->task_pid(tc->task);
 	psinfo->pr_pgrp = ggt->task_pgrp(tc->task);
 	psinfo->pr_sid = ggt->task_session(tc->task);
 
-	readmem(tc->task + OFFSET(task_struct_state), KVADDR, &state, sizeof(state),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_state), &state, sizeof(state),
 		"fill_psinfo: state", gcore_verbose_error_handle());
 
         i = state ? ffz(~state) + 1 : 0;
@@ -350,7 +541,8 @@ fill_psinfo_note(struct elf_note_info *info, struct task_context *tc,
 
 	psinfo->pr_nice = task_nice(tc->task);
 
-	readmem(tc->task + OFFSET(task_struct_flags), KVADDR, &psinfo->pr_flag,
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_flags), &psinfo->pr_flag,
 		sizeof(psinfo->pr_flag), "fill_psinfo: flags",
 		gcore_verbose_error_handle());
 
@@ -360,9 +552,9 @@ fill_psinfo_note(struct elf_note_info *info, struct task_context *tc,
 	SET_UID(psinfo->pr_uid, (uid_t)uid);
 	SET_GID(psinfo->pr_gid, (gid_t)gid);
 
-	readmem(tc->task + OFFSET(task_struct_comm), KVADDR, &psinfo->pr_fname,
-		TASK_COMM_LEN, "fill_psinfo: comm",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_comm), &psinfo->pr_fname, TASK_COMM_LEN,
+		"fill_psinfo: comm", gcore_verbose_error_handle());
 
 }
 
@@ -405,16 +597,17 @@ compat_fill_psinfo_note(struct elf_note_info *info,
                         psinfo->pr_psargs[i] = ' ';
         psinfo->pr_psargs[len] = 0;
 
-	readmem(tc->task + GCORE_OFFSET(task_struct_real_parent), KVADDR,
-		&parent, sizeof(parent), "fill_psinfo: real_parent",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		GCORE_OFFSET(task_struct_real_parent), &parent, sizeof(parent),
+		"fill_psinfo: real_parent", gcore_verbose_error_handle());
 
 	psinfo->pr_ppid = ggt->task_pid(parent);
 	psinfo->pr_pid = ggt->task_pid(tc->task);
 	psinfo->pr_pgrp = ggt->task_pgrp(tc->task);
 	psinfo->pr_sid = ggt->task_session(tc->task);
 
-	readmem(tc->task + OFFSET(task_struct_state), KVADDR, &state, sizeof(state),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_state), &state, sizeof(state),
 		"fill_psinfo: state", gcore_verbose_error_handle());
 
         i = state ? ffz(~state) + 1 : 0;
@@ -424,7 +617,8 @@ compat_fill_psinfo_note(struct elf_note_info *info,
 
 	psinfo->pr_nice = task_nice(tc->task);
 
-	readmem(tc->task + OFFSET(task_struct_flags), KVADDR, &psinfo->pr_flag,
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_flags), &psinfo->pr_flag,
 		sizeof(psinfo->pr_flag), "fill_psinfo: flags",
 		gcore_verbose_error_handle());
 
@@ -434,9 +628,9 @@ compat_fill_psinfo_note(struct elf_note_info *info,
 	SET_UID(psinfo->pr_uid, (__compat_uid_t)uid);
 	SET_GID(psinfo->pr_gid, (__compat_gid_t)gid);
 
-	readmem(tc->task + OFFSET(task_struct_comm), KVADDR, &psinfo->pr_fname,
-		TASK_COMM_LEN, "fill_psinfo: comm",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_comm), &psinfo->pr_fname, TASK_COMM_LEN,
+		"fill_psinfo: comm", gcore_verbose_error_handle());
 
 }
 
@@ -456,13 +650,15 @@ static void fill_elf_header(int phnum)
 }
 
 static void
-fill_write_thread_core_info(FILE *fp, struct task_context *tc,
+fill_write_thread_core_info(struct gcore_writer *writer,
+			    struct task_context *tc,
 			    struct task_context *dump_tc,
 			    struct elf_note_info *info,
 			    const struct user_regset_view *view,
 			    loff_t *offset, size_t *total)
 {
 	unsigned int i;
+	int ret;
 	char *buf;
 	struct memelfnote memnote;
 
@@ -472,14 +668,16 @@ fill_write_thread_core_info(FILE *fp, struct task_context *tc,
          * We assume that regset 0 is NT_PRSTATUS.
          */
 	buf = GETBUF(view->regsets[0].size);
+	gcore_phase_begin(GCORE_PHASE_REGSETS);
 	view->regsets[0].get(tc, &view->regsets[0],
 			     view->regsets[0].size, buf);
+	gcore_phase_end(GCORE_PHASE_REGSETS);
 	/* We pass actual object in case of prstatus. We don't do this
 	 * in other cases. */
 	memnote.data = buf;
 	info->fill_prstatus_note(info, tc, &memnote);
         *total += notesize(&memnote);
-	writenote(&memnote, fp, offset);
+	writenote(&memnote, writer, offset);
 	FREEBUF(buf);
 	FREEBUF(memnote.data);
 
@@ -489,17 +687,17 @@ fill_write_thread_core_info(FILE *fp, struct task_context *tc,
 	if (tc == dump_tc) {
 		info->fill_psinfo_note(info, dump_tc, &memnote);
 		info->size += notesize(&memnote);
-		writenote(&memnote, fp, offset);
+		writenote(&memnote, writer, offset);
 		FREEBUF(memnote.data);
 
 		info->fill_auxv_note(info, dump_tc, &memnote);
 		info->size += notesize(&memnote);
-		writenote(&memnote, fp, offset);
+		writenote(&memnote, writer, offset);
 		FREEBUF(memnote.data);
 
 		if (info->fill_files_note(info, dump_tc, &memnote)) {
 			info->size += notesize(&memnote);
-			writenote(&memnote, fp, offset);
+			writenote(&memnote, writer, offset);
 			FREEBUF(memnote.data);
 		}
 	}
@@ -513,13 +711,16 @@ fill_write_thread_core_info(FILE *fp, struct task_context *tc,
 		    !regset->active(tc, regset))
 			continue;
 		buf = GETBUF(regset->size);
-		if (regset->get(tc, regset, regset->size, buf))
+		gcore_phase_begin(GCORE_PHASE_REGSETS);
+		ret = regset->get(tc, regset, regset->size, buf);
+		gcore_phase_end(GCORE_PHASE_REGSETS);
+		if (ret)
 			goto fail;
 
 		fill_note(&memnote, regset->name, regset->core_note_type,
 			  regset->size, buf);
 		*total += notesize(&memnote);
-		writenote(&memnote, fp, offset);
+		writenote(&memnote, writer, offset);
 	fail:
 		FREEBUF(buf);
 	}
@@ -550,8 +751,8 @@ static struct elf_note_info *elf_note_info_init(void)
 }
 
 static int
-fill_write_note_info(FILE *fp, struct elf_note_info *info, int phnum,
-		     loff_t *offset)
+fill_write_note_info(struct gcore_writer *writer, struct elf_note_info *info,
+		     int phnum, loff_t *offset)
 {
 	const struct user_regset_view *view = task_user_regset_view();
 	struct task_context *tc;
@@ -572,16 +773,18 @@ fill_write_note_info(FILE *fp, struct elf_note_info *info, int phnum,
 	    view->regsets[0].core_note_type != NT_PRSTATUS)
 		error(FATAL, "regset 0 is _not_ NT_PRSTATUS\n");
 
+	prefetch_thread_group(dump_tc);
+
 	/*
 	 * Put dump task note information first. This is a common
 	 * convension we can see in core dump generated by linux
 	 * process core dumper and gdb gcore.
 	 */
-	fill_write_thread_core_info(fp, dump_tc, dump_tc, info, view,
+	fill_write_thread_core_info(writer, dump_tc, dump_tc, info, view,
 				    offset, &info->size);
-	FOR_EACH_TASK_IN_THREAD_GROUP(task_tgid(dump_tc->task), tc) {
+	FOR_EACH_TASK_IN_THREAD_GROUP(gcore_task_tgid(dump_tc), tc) {
 		if (tc != dump_tc) {
-			fill_write_thread_core_info(fp, tc, dump_tc, info,
+			fill_write_thread_core_info(writer, tc, dump_tc, info,
 						    view, offset, &info->size);
 		}
 	}
@@ -589,6 +792,115 @@ fill_write_note_info(FILE *fp, struct elf_note_info *info, int phnum,
 	return 0;
 }
 
+/*
+ * With -j threads, read the task_struct of every thread of the dump
+ * task in parallel, and then the areas it points to: the user
+ * registers saved at the top of the kernel stack, the FPU state when
+ * it is kept outside task_struct, and the cred. This is done before
+ * note information is collected thread by thread. The regset
+ * callbacks themselves go through crash, which is not reentrant, so
+ * they still run serially, but most of their reads are then served by
+ * the object cache.
+ */
+static void prefetch_thread_group(struct task_context *dump_tc)
+{
+	struct task_context *tc;
+	ulong *objs, tgid = gcore_task_tgid(dump_tc);
+	int i, nr = 0;
+
+	if (gcore_parallel_get() < 2)
+		return;
+
+	FOR_EACH_TASK_IN_THREAD_GROUP(tgid, tc)
+		nr++;
+
+	objs = (ulong *)GETBUF(nr * sizeof(ulong));
+
+	i = 0;
+	FOR_EACH_TASK_IN_THREAD_GROUP(tgid, tc)
+		objs[i++] = tc->task;
+
+	gcore_objcache_prefetch(GCORE_OBJ_TASK, objs, nr);
+
+	i = 0;
+	FOR_EACH_TASK_IN_THREAD_GROUP(tgid, tc)
+		objs[i++] = gcore_arch_user_regs(tc);
+
+	gcore_objcache_prefetch(GCORE_OBJ_PT_REGS, objs, nr);
+
+	i = 0;
+	FOR_EACH_TASK_IN_THREAD_GROUP(tgid, tc)
+		objs[i++] = gcore_arch_fpu_area(tc);
+
+	gcore_objcache_prefetch(GCORE_OBJ_FPU, objs, nr);
+
+	if (GCORE_VALID_MEMBER(task_struct_real_cred)) {
+		i = 0;
+		FOR_EACH_TASK_IN_THREAD_GROUP(tgid, tc) {
+			if (!gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+				GCORE_OFFSET(task_struct_real_cred), &objs[i],
+				sizeof(objs[i]), "prefetch_thread_group: cred",
+				RETURN_ON_ERROR|QUIET))
+				objs[i] = 0;
+			i++;
+		}
+		gcore_objcache_prefetch(GCORE_OBJ_CRED, objs, nr);
+	}
+
+	FREEBUF(objs);
+}
+
+/*
+ * Write the note listing the pages that could not be read at the end
+ * of the data, and fill in its program header at @phdr. Compressed or
+ * streamed cores cannot go back to the header, so the ranges are then
+ * only reported.
+ */
+static void write_bad_ranges_note(off_t phdr)
+{
+	struct memelfnote memnote;
+	ulong i, nr, *ranges;
+	uint64_t *desc;
+	loff_t offset, start;
+
+	if (!(nr = gcore_copy_get_bad_ranges(&ranges)))
+		return;
+
+	error(WARNING, "%s: %lu pages could not be read and are left as "
+	      "holes\n", gcore->corename, gcore_copy_get_stats()->bad);
+	for (i = 0; i < nr; i++)
+		progressf("unreadable: [%lx, %lx)\n", ranges[2 * i],
+			  ranges[2 * i + 1]);
+
+	if (gcore_writer_fd(gcore->writer) < 0) {
+		error(WARNING, "%s: no bad ranges note in a compressed or "
+		      "streamed core\n", gcore->corename);
+		return;
+	}
+
+	desc = (uint64_t *)GETBUF(2 * nr * sizeof(uint64_t));
+	for (i = 0; i < 2 * nr; i++)
+		desc[i] = ranges[i];
+
+	fill_note(&memnote, "GCORE", NT_GCORE_BAD_RANGES,
+		  2 * nr * sizeof(uint64_t), desc);
+
+	start = offset = gcore_writer_tell(gcore->writer);
+	writenote(&memnote, gcore->writer, &offset);
+
+	if (!gcore_writer_seek(gcore->writer, phdr))
+		error(FATAL, "%s: seek: %s\n", gcore->corename,
+		      strerror(errno));
+	gcore->elf->ops->fill_program_header(gcore->elf, PT_NOTE, 0, start, 0,
+					     notesize(&memnote), 0, 0);
+	if (!gcore->elf->ops->write_program_header(gcore->elf,
+						   gcore->writer))
+		error(FATAL, "%s: write: %s\n", gcore->corename,
+		      strerror(errno));
+
+	FREEBUF(desc);
+}
+
 static int
 notesize(struct memelfnote *en)
 {
@@ -613,13 +925,13 @@ fill_note(struct memelfnote *note, const char *name, int type, unsigned int sz,
 }
 
 static void
-alignfile(FILE *fp, loff_t *foffset)
+alignfile(struct gcore_writer *writer, loff_t *foffset)
 {
         static const char buffer[4] = {};
 	const size_t len = roundup(*foffset, 4) - *foffset;
 
 	if (len > 0) {
-		if (fwrite(buffer, len, 1, fp) != 1)
+		if (!gcore_writer_write(writer, buffer, len))
 			error(FATAL, "%s: write %s\n", gcore->corename,
 			      strerror(errno));
 		*foffset += (loff_t)len;
@@ -627,7 +939,8 @@ alignfile(FILE *fp, loff_t *foffset)
 }
 
 static void
-writenote(struct memelfnote *men, FILE *fp, loff_t *foffset)
+writenote(struct memelfnote *men, struct gcore_writer *writer,
+	  loff_t *foffset)
 {
 	uint32_t n_namesz, n_descsz, n_type;
 
@@ -638,23 +951,23 @@ writenote(struct memelfnote *men, FILE *fp, loff_t *foffset)
 	gcore->elf->ops->fill_note_header(gcore->elf, n_namesz, n_descsz,
 					  n_type);
 
-	if (!gcore->elf->ops->write_note_header(gcore->elf, fp, foffset))
+	if (!gcore->elf->ops->write_note_header(gcore->elf, writer, foffset))
 		error(FATAL, "%s: write %s\n", gcore->corename,
 		      strerror(errno));
 
-	if (fwrite(men->name, n_namesz, 1, fp) != 1)
+	if (!gcore_writer_write(writer, men->name, n_namesz))
 		error(FATAL, "%s: write %s\n", gcore->corename,
 		      strerror(errno));
 	*foffset += n_namesz;
 
-        alignfile(fp, foffset);
+        alignfile(writer, foffset);
 
-	if (fwrite(men->data, men->datasz, 1, fp) != 1)
+	if (!gcore_writer_write(writer, men->data, men->datasz))
 		error(FATAL, "%s: write %s\n", gcore->corename,
 		      strerror(errno));
 	*foffset += men->datasz;
 
-        alignfile(fp, foffset);
+        alignfile(writer, foffset);
 
 }
 
@@ -664,8 +977,27 @@ get_note_info_size(struct elf_note_info *info)
 	return info->size;
 }
 
+/**
+ * Return what to pass as @mmap to first_vma() for the mm_struct at
+ * @mm, cached at @mm_cache.
+ */
+ulong gcore_mm_vmas(ulong mm, char *mm_cache)
+{
+	if (gcore_maple_vma_tree())
+		return mm + GCORE_OFFSET(mm_struct_mm_mt);
+
+	return ULONG(mm_cache + OFFSET(mm_struct_mmap));
+}
+
 ulong first_vma(ulong mmap, ulong gate_vma)
 {
+	ulong vma;
+
+	if (mmap && gcore_maple_vma_tree()) {
+		vma = gcore_maple_first_vma(mmap);
+		return vma ? vma : gate_vma;
+	}
+
 	return mmap ? mmap : gate_vma;
 }
 
@@ -673,6 +1005,13 @@ ulong next_vma(ulong this_vma, ulong gate_vma)
 {
 	ulong next;
 
+	if (gcore_maple_vma_tree()) {
+		if (this_vma == gate_vma)
+			return 0UL;
+		next = gcore_maple_next_vma(this_vma);
+		return next ? next : gate_vma;
+	}
+
 	next = ULONG(fill_vma_cache(this_vma) + OFFSET(vm_area_struct_vm_next));
 	if (next)
 		return next;
@@ -681,15 +1020,139 @@ ulong next_vma(ulong this_vma, ulong gate_vma)
 	return gate_vma;
 }
 
+/*
+ * The task table sorted by thread group, in task table order within
+ * each group; pos[] maps a task table index to its entry.
+ */
+struct gcore_thread_group_entry
+{
+	ulong tgid;
+	ulong index;
+};
+
+struct gcore_thread_group_index
+{
+	struct gcore_thread_group_entry *entries;
+	ulong *pos;
+	ulong nr_tasks;
+};
+
+static struct gcore_thread_group_index gcore_thread_group_index;
+static struct gcore_thread_group_index *gtg = &gcore_thread_group_index;
+
+static int thread_group_compare(const void *a, const void *b)
+{
+	const struct gcore_thread_group_entry *x = a, *y = b;
+
+	if (x->tgid != y->tgid)
+		return x->tgid < y->tgid ? -1 : 1;
+
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/*
+ * Read the tgid of every task once and sort the task table by it.
+ * The index is allocated with malloc(), as it outlives the
+ * free_all_bufs() after each task of the command.
+ */
+static void thread_group_index_init(void)
+{
+	struct task_context *tc;
+	ulong i, n = RUNNING_TASKS();
+
+	gtg->entries = malloc(n * sizeof(*gtg->entries));
+	gtg->pos = malloc(n * sizeof(*gtg->pos));
+	if (!gtg->entries || !gtg->pos) {
+		gcore_thread_group_reset();
+		error(FATAL, "cannot allocate the thread group index\n");
+	}
+
+	tc = FIRST_CONTEXT();
+	for (i = 0; i < n; i++, tc++) {
+		int tgid;
+
+		/* Only the tgid field, rather than the whole task_struct. */
+		if (readmem(tc->task + OFFSET(task_struct_tgid), KVADDR,
+			    &tgid, sizeof(tgid), "thread group index: tgid",
+			    RETURN_ON_ERROR|QUIET))
+			gtg->entries[i].tgid = tgid;
+		else
+			gtg->entries[i].tgid = task_tgid(tc->task);
+		gtg->entries[i].index = i;
+	}
+
+	qsort(gtg->entries, n, sizeof(*gtg->entries), thread_group_compare);
+
+	for (i = 0; i < n; i++)
+		gtg->pos[gtg->entries[i].index] = i;
+
+	gtg->nr_tasks = n;
+}
+
+/**
+ * Drop the thread group index.
+ */
+void gcore_thread_group_reset(void)
+{
+	free(gtg->entries);
+	free(gtg->pos);
+	BZERO(gtg, sizeof(*gtg));
+}
+
+/**
+ * Return the tgid of @tc from the thread group index.
+ */
+ulong gcore_task_tgid(struct task_context *tc)
+{
+	if (!gtg->entries)
+		thread_group_index_init();
+
+	return gtg->entries[gtg->pos[tc - FIRST_CONTEXT()]].tgid;
+}
+
+/**
+ * Return the first task in thread group @tgid, in task table order,
+ * or NULL if there is none.
+ */
+struct task_context *first_task_context(ulong tgid)
+{
+	ulong lo, hi;
+
+	if (!gtg->entries)
+		thread_group_index_init();
+
+	lo = 0;
+	hi = gtg->nr_tasks;
+	while (lo < hi) {
+		ulong mid = lo + (hi - lo) / 2;
+
+		if (gtg->entries[mid].tgid < tgid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == gtg->nr_tasks || gtg->entries[lo].tgid != tgid)
+		return NULL;
+
+	return FIRST_CONTEXT() + gtg->entries[lo].index;
+}
+
+/**
+ * Return the task following @tc in thread group @tgid, or NULL.
+ */
 struct task_context *next_task_context(ulong tgid, struct task_context *tc)
 {
-	const struct task_context * const end = FIRST_CONTEXT() + RUNNING_TASKS();
+	ulong i;
+
+	if (!gtg->entries)
+		thread_group_index_init();
 
-	for (++tc; tc < end; ++tc)
-		if (task_tgid(tc->task) == tgid)
-			return tc;
+	i = gtg->pos[tc - FIRST_CONTEXT()] + 1;
+	if (i == gtg->nr_tasks || gtg->entries[i].tgid != tgid)
+		return NULL;
 
-	return NULL;
+	return FIRST_CONTEXT() + gtg->entries[i].index;
 }
 
 static void
@@ -712,22 +1175,25 @@ fill_prstatus_note(struct elf_note_info *info, struct task_context *tc,
         fill_note(memnote, "CORE", NT_PRSTATUS, sizeof(*prstatus), prstatus);
 
         /* The type of (sig[0]) is unsigned long. */
-	readmem(tc->task + OFFSET(task_struct_pending) + OFFSET(sigpending_signal),
-		KVADDR, &pending_signal_sig0, sizeof(unsigned long),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_pending) + OFFSET(sigpending_signal),
+		&pending_signal_sig0, sizeof(unsigned long),
 		"fill_prstatus: sigpending_signal_sig",
 		gcore_verbose_error_handle());
 
-	readmem(tc->task + OFFSET(task_struct_blocked), KVADDR, &blocked_sig0,
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_blocked), &blocked_sig0,
 		sizeof(unsigned long), "fill_prstatus: blocked_sig0",
 		gcore_verbose_error_handle());
 
-	readmem(tc->task + OFFSET(task_struct_parent), KVADDR, &real_parent,
-		sizeof(real_parent), "fill_prstatus: real_parent",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_parent), &real_parent, sizeof(real_parent),
+		"fill_prstatus: real_parent", gcore_verbose_error_handle());
 
-	readmem(tc->task + GCORE_OFFSET(task_struct_group_leader), KVADDR,
-		&group_leader, sizeof(group_leader),
-		"fill_prstatus: group_leader", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		GCORE_OFFSET(task_struct_group_leader), &group_leader,
+		sizeof(group_leader), "fill_prstatus: group_leader",
+		gcore_verbose_error_handle());
 
 	prstatus->pr_info.si_signo = prstatus->pr_cursig = 0;
         prstatus->pr_sigpend = pending_signal_sig0;
@@ -750,20 +1216,21 @@ fill_prstatus_note(struct elf_note_info *info, struct task_context *tc,
         } else {
 		cputime_t utime, stime;
 
-		readmem(tc->task + OFFSET(task_struct_utime), KVADDR, &utime,
-			sizeof(utime), "task_struct utime",
-			gcore_verbose_error_handle());
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			OFFSET(task_struct_utime), &utime, sizeof(utime),
+			"task_struct utime", gcore_verbose_error_handle());
 
-		readmem(tc->task + OFFSET(task_struct_stime), KVADDR, &stime,
-			sizeof(stime), "task_struct stime",
-			gcore_verbose_error_handle());
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			OFFSET(task_struct_stime), &stime, sizeof(stime),
+			"task_struct stime", gcore_verbose_error_handle());
 
                 cputime_to_timeval(utime, &prstatus->pr_utime);
                 cputime_to_timeval(stime, &prstatus->pr_stime);
         }
 
-	readmem(tc->task + OFFSET(task_struct_signal), KVADDR, &signal,
-		sizeof(signal), "task_struct signal", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_signal), &signal, sizeof(signal),
+		"task_struct signal", gcore_verbose_error_handle());
 
 	readmem(tc->task + GCORE_OFFSET(signal_struct_cutime), KVADDR,
 		&cutime, sizeof(cutime), "signal_struct cutime",
@@ -798,22 +1265,25 @@ compat_fill_prstatus_note(struct elf_note_info *info,
         fill_note(memnote, "CORE", NT_PRSTATUS, sizeof(*prstatus), prstatus);
 
         /* The type of (sig[0]) is unsigned long. */
-	readmem(tc->task + OFFSET(task_struct_pending) + OFFSET(sigpending_signal),
-		KVADDR, &pending_signal_sig0, sizeof(unsigned long),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_pending) + OFFSET(sigpending_signal),
+		&pending_signal_sig0, sizeof(unsigned long),
 		"fill_prstatus: sigpending_signal_sig",
 		gcore_verbose_error_handle());
 
-	readmem(tc->task + OFFSET(task_struct_blocked), KVADDR, &blocked_sig0,
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_blocked), &blocked_sig0,
 		sizeof(unsigned long), "fill_prstatus: blocked_sig0",
 		gcore_verbose_error_handle());
 
-	readmem(tc->task + OFFSET(task_struct_parent), KVADDR, &real_parent,
-		sizeof(real_parent), "fill_prstatus: real_parent",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_parent), &real_parent, sizeof(real_parent),
+		"fill_prstatus: real_parent", gcore_verbose_error_handle());
 
-	readmem(tc->task + GCORE_OFFSET(task_struct_group_leader), KVADDR,
-		&group_leader, sizeof(group_leader),
-		"fill_prstatus: group_leader", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		GCORE_OFFSET(task_struct_group_leader), &group_leader,
+		sizeof(group_leader), "fill_prstatus: group_leader",
+		gcore_verbose_error_handle());
 
 	prstatus->pr_info.si_signo = prstatus->pr_cursig = 0;
         prstatus->pr_sigpend = pending_signal_sig0;
@@ -836,21 +1306,21 @@ compat_fill_prstatus_note(struct elf_note_info *info,
         } else {
 		cputime_t utime, stime;
 
-		readmem(tc->task + OFFSET(task_struct_utime), KVADDR, &utime,
-			sizeof(utime), "task_struct utime",
-			gcore_verbose_error_handle());
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			OFFSET(task_struct_utime), &utime, sizeof(utime),
+			"task_struct utime", gcore_verbose_error_handle());
 
-		readmem(tc->task + OFFSET(task_struct_stime), KVADDR, &stime,
-			sizeof(stime), "task_struct stime",
-			gcore_verbose_error_handle());
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			OFFSET(task_struct_stime), &stime, sizeof(stime),
+			"task_struct stime", gcore_verbose_error_handle());
 
                 cputime_to_compat_timeval(utime, &prstatus->pr_utime);
                 cputime_to_compat_timeval(stime, &prstatus->pr_stime);
         }
 
-	readmem(tc->task + OFFSET(task_struct_signal), KVADDR, &signal,
-		sizeof(signal), "task_struct signal",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_signal), &signal, sizeof(signal),
+		"task_struct signal", gcore_verbose_error_handle());
 
 	readmem(tc->task + GCORE_OFFSET(signal_struct_cutime), KVADDR,
 		&cutime, sizeof(cutime), "signal_struct cutime",
@@ -918,14 +1388,36 @@ compat_fill_auxv_note(struct elf_note_info *info,
 
 #endif /* GCORE_ARCH_COMPAT */
 
+/*
+ * Put the path name of @file in @buf, of BUFSIZE bytes. @buf is left
+ * as is if the file has no dentry.
+ */
+static void fill_file_pathname(ulong file, char *buf)
+{
+	char *file_buf;
+	ulong dentry, vfsmnt;
+
+	file_buf = fill_file_cache(file);
+	dentry = ULONG(file_buf + OFFSET(file_f_dentry));
+	if (dentry) {
+		fill_dentry_cache(dentry);
+		if (VALID_MEMBER(file_f_vfsmnt)) {
+			vfsmnt = ULONG(file_buf + OFFSET(file_f_vfsmnt));
+			get_pathname(dentry, buf, BUFSIZE, 1, vfsmnt);
+		} else {
+			get_pathname(dentry, buf, BUFSIZE, 1, 0);
+		}
+	}
+}
+
 static int
 fill_files_note(struct elf_note_info *info, struct task_context *tc,
 	       struct memelfnote *memnote)
 {
-	ulong mmap, gate_vma, vma, vm_start, vm_end, vm_file, vm_pgoff, dentry, vfsmnt;
+	ulong vm_file, last_file;
 	unsigned count, map_count, size, names_ofs, remaining, n, index;
 	ulong *data, *start_end_ofs;
-	char *name_base, *name_curpos, *file_buf, *mm_cache;
+	char *name_base, *name_curpos, *mm_cache;
 	char buf[BUFSIZE];
 
 	BZERO(buf, BUFSIZE);
@@ -936,9 +1428,6 @@ fill_files_note(struct elf_note_info *info, struct task_context *tc,
 		return FALSE;
 	}
 
-	mmap = ULONG(mm_cache + OFFSET(mm_struct_mmap));
-	gate_vma = gcore_arch_get_gate_vma();
-
 	/* *Estimated* file count and total data size needed */
 	map_count = count = INT(mm_cache + GCORE_OFFSET(mm_struct_map_count));
 	if (count > UINT_MAX / 64) {
@@ -962,31 +1451,22 @@ fill_files_note(struct elf_note_info *info, struct task_context *tc,
 	remaining = size - names_ofs;
 	count = 0;
 
-	FOR_EACH_VMA_OBJECT(vma, index, mmap, gate_vma) {
-		char *vma_cache;
+	last_file = 0;
 
-		if (!IS_KVADDR(vma))
-			continue;
+	for (index = 0; index < gcore->nr_vmas; index++) {
+		struct gcore_vma *v = &gcore->vmas[index];
 
-		vma_cache = fill_vma_cache(vma);
-		vm_start = ULONG(vma_cache + OFFSET(vm_area_struct_vm_start));
-		vm_end = ULONG(vma_cache + OFFSET(vm_area_struct_vm_end));
-		vm_file = ULONG(vma_cache + OFFSET(vm_area_struct_vm_file));
-		vm_pgoff = ULONG(vma_cache + OFFSET(vm_area_struct_vm_pgoff));
+		if (!IS_KVADDR(v->vma))
+			continue;
 
+		vm_file = v->file;
 		if (!vm_file)
 			continue;
 
-		file_buf = fill_file_cache(vm_file);
-		dentry = ULONG(file_buf + OFFSET(file_f_dentry));
-		if (dentry) {
-			fill_dentry_cache(dentry);
-			if (VALID_MEMBER(file_f_vfsmnt)) {
-				vfsmnt = ULONG(file_buf + OFFSET(file_f_vfsmnt));
-				get_pathname(dentry, buf, BUFSIZE, 1, vfsmnt);
-			} else {
-				get_pathname(dentry, buf, BUFSIZE, 1, 0);
-			}
+		/* Mappings of one file usually come in a row. */
+		if (vm_file != last_file) {
+			fill_file_pathname(vm_file, buf);
+			last_file = vm_file;
 		}
 
 		/* get_pathname() fills at the end, move name down */
@@ -996,9 +1476,9 @@ fill_files_note(struct elf_note_info *info, struct task_context *tc,
 		progressf("FILE %s\n", name_curpos);
 		name_curpos += n;
 
-		*start_end_ofs++ = vm_start;
-		*start_end_ofs++ = vm_end;
-		*start_end_ofs++ = vm_pgoff;
+		*start_end_ofs++ = v->start;
+		*start_end_ofs++ = v->end;
+		*start_end_ofs++ = v->pgoff;
 		count++;
 	}
 
@@ -1029,10 +1509,10 @@ static int
 compat_fill_files_note(struct elf_note_info *info, struct task_context *tc,
 		       struct memelfnote *memnote)
 {
-	ulong mmap, gate_vma, vma, vm_start, vm_end, vm_file, vm_pgoff, dentry, vfsmnt;
+	ulong vm_file, last_file;
 	unsigned count, map_count, size, names_ofs, remaining, n, index;
 	unsigned int *data, *start_end_ofs;
-	char *name_base, *name_curpos, *file_buf, *mm_cache;
+	char *name_base, *name_curpos, *mm_cache;
 	char buf[BUFSIZE];
 
 	BZERO(buf, BUFSIZE);
@@ -1043,9 +1523,6 @@ compat_fill_files_note(struct elf_note_info *info, struct task_context *tc,
 		return FALSE;
 	}
 
-	mmap = ULONG(mm_cache + OFFSET(mm_struct_mmap));
-	gate_vma = gcore_arch_get_gate_vma();
-
 	/* *Estimated* file count and total data size needed */
 	map_count = count = INT(mm_cache + GCORE_OFFSET(mm_struct_map_count));
 	if (count > UINT_MAX / 64) {
@@ -1069,31 +1546,22 @@ compat_fill_files_note(struct elf_note_info *info, struct task_context *tc,
 	remaining = size - names_ofs;
 	count = 0;
 
-	FOR_EACH_VMA_OBJECT(vma, index, mmap, gate_vma) {
-		char *vma_cache;
+	last_file = 0;
 
-		if (!IS_KVADDR(vma))
-			continue;
+	for (index = 0; index < gcore->nr_vmas; index++) {
+		struct gcore_vma *v = &gcore->vmas[index];
 
-		vma_cache = fill_vma_cache(vma);
-		vm_start = ULONG(vma_cache + OFFSET(vm_area_struct_vm_start));
-		vm_end = ULONG(vma_cache + OFFSET(vm_area_struct_vm_end));
-		vm_file = ULONG(vma_cache + OFFSET(vm_area_struct_vm_file));
-		vm_pgoff = ULONG(vma_cache + OFFSET(vm_area_struct_vm_pgoff));
+		if (!IS_KVADDR(v->vma))
+			continue;
 
+		vm_file = v->file;
 		if (!vm_file)
 			continue;
 
-		file_buf = fill_file_cache(vm_file);
-		dentry = ULONG(file_buf + OFFSET(file_f_dentry));
-		if (dentry) {
-			fill_dentry_cache(dentry);
-			if (VALID_MEMBER(file_f_vfsmnt)) {
-				vfsmnt = ULONG(file_buf + OFFSET(file_f_vfsmnt));
-				get_pathname(dentry, buf, BUFSIZE, 1, vfsmnt);
-			} else {
-				get_pathname(dentry, buf, BUFSIZE, 1, 0);
-			}
+		/* Mappings of one file usually come in a row. */
+		if (vm_file != last_file) {
+			fill_file_pathname(vm_file, buf);
+			last_file = vm_file;
 		}
 
 		/* get_pathname() fills at the end, move name down */
@@ -1103,9 +1571,9 @@ compat_fill_files_note(struct elf_note_info *info, struct task_context *tc,
 		progressf("FILE %s\n", name_curpos);
 		name_curpos += n;
 
-		*start_end_ofs++ = vm_start;
-		*start_end_ofs++ = vm_end;
-		*start_end_ofs++ = vm_pgoff;
+		*start_end_ofs++ = v->start;
+		*start_end_ofs++ = v->end;
+		*start_end_ofs++ = v->pgoff;
 		count++;
 	}
 
@@ -1131,52 +1599,3 @@ compat_fill_files_note(struct elf_note_info *info, struct task_context *tc,
 	return TRUE;
 }
 #endif /* GCORE_ARCH_COMPAT */
-
-static int uvtop_quiet(ulong vaddr, physaddr_t *paddr)
-{
-	FILE *saved_fp = fp;
-	int page_present;
-
-	/* uvtop() with verbose FALSE returns wrong physical address
-	 * for gate_vma. The problem is that kvtop() wrongly thinks of
-	 * the fixed address 0xffffffffff600000 as the one that
-	 * belongs to direct mapping region and calculates the result
-	 * by substracting offset of direct-mapping space from the
-	 * fixed address. However, it's necessary to do paging to get
-	 * correct physical address.
-	 *
-	 * uvtop() does paging if verbose == TRUE. Then, it retuns
-	 * correct physical address.
-	 *
-	 * Next output of vtop clarifies this bug, where the first
-	 * PHYSICAL showing 0x7f600000 is wrong one and the PHYSICAL
-	 * in the last line showing 0x1c08000 is correct one.
-	 *
-	 * crash> vtop 0xffffffffff600000
-	 * VIRTUAL           PHYSICAL        
-	 * ffffffffff600000  7f600000        
-	 *
-	 * PML4 DIRECTORY: ffffffff81a85000
-	 * PAGE DIRECTORY: 1a87067
-	 *    PUD: 1a87ff8 => 1a88067
-	 *    PMD: 1a88fd8 => 28049067
-	 *    PTE: 28049000 => 1c08165
-	 *   PAGE: 1c08000
-	 *
-	 *   PTE    PHYSICAL  FLAGS
-	 * 1c08165   1c08000  (PRESENT|USER|ACCESSED|DIRTY|GLOBAL)
-	 *
-	 *       PAGE        PHYSICAL      MAPPING       INDEX CNT FLAGS
-	 * ffffea00000621c0   1c08000                0        0  1 20000000000400
-	 *
-	 * The remaining problem is that if specifying TRUE to
-	 * verbose, same information is displayed during gcore
-	 * processing. To avoid this, we assign the file pointer to
-	 * /dev/null to fp during call of uvtop().
-	 */
-	fp = pc->nullfp;
-	page_present = uvtop(CURRENT_CONTEXT(), vaddr, paddr, TRUE);
-	fp = saved_fp;
-
-	return page_present;
-}
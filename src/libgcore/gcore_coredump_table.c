@@ -154,11 +154,13 @@ process_group(ulong task)
 	ulong signal;
 	pid_t pgrp;
 
-	readmem(task + OFFSET(task_struct_signal), KVADDR, &signal,
-		sizeof(signal), "process_group: signal", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task, OFFSET(task_struct_signal),
+		&signal, sizeof(signal), "process_group: signal",
+		gcore_verbose_error_handle());
 
-	readmem(signal + GCORE_OFFSET(signal_struct_pgrp), KVADDR, &pgrp,
-		sizeof(pgrp), "process_group: pgrp", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_pgrp), &pgrp, sizeof(pgrp),
+		"process_group: pgrp", gcore_verbose_error_handle());
 
 	return pgrp;
 }
@@ -169,13 +171,14 @@ task_session(ulong task)
 	ulong signal;
 	pid_t session;
 
-	readmem(task + OFFSET(task_struct_signal), KVADDR, &signal,
-		sizeof(signal), "process_group: signal", gcore_verbose_error_handle());
-
-	readmem(signal + GCORE_OFFSET(signal_struct_session), KVADDR,
-		&session, sizeof(session), "task_session: session",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task, OFFSET(task_struct_signal),
+		&signal, sizeof(signal), "process_group: signal",
 		gcore_verbose_error_handle());
 
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_session), &session, sizeof(session),
+		"task_session: session", gcore_verbose_error_handle());
+
 	return session;
 }
 
@@ -186,11 +189,13 @@ pid_nr_ns(ulong pid, ulong ns)
 	unsigned int ns_level, pid_level;
 	pid_t nr = 0;
 
-	readmem(ns + GCORE_OFFSET(pid_namespace_level), KVADDR, &ns_level,
-		sizeof(ns_level), "pid_nr_ns: ns_level", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_PID_NS, ns,
+		GCORE_OFFSET(pid_namespace_level), &ns_level, sizeof(ns_level),
+		"pid_nr_ns: ns_level", gcore_verbose_error_handle());
 
-	readmem(pid + GCORE_OFFSET(pid_level), KVADDR, &pid_level,
-		sizeof(pid_level), "pid_nr_ns: pid_level", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_PID, pid, GCORE_OFFSET(pid_level),
+		&pid_level, sizeof(pid_level), "pid_nr_ns: pid_level",
+		gcore_verbose_error_handle());
 
         if (pid && ns_level <= pid_level) {
 		ulong upid_ns;
@@ -216,48 +221,49 @@ __task_pid_nr_ns(ulong task, enum pid_type type)
 	ulong nsproxy, ns;
 	int nr = 0;
 
-	readmem(task + OFFSET(task_struct_nsproxy), KVADDR, &nsproxy,
-		sizeof(nsproxy), "__task_pid_nr_ns: nsproxy",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_nsproxy), &nsproxy, sizeof(nsproxy),
+		"__task_pid_nr_ns: nsproxy", gcore_verbose_error_handle());
 
-	readmem(nsproxy + GCORE_OFFSET(nsproxy_pid_ns), KVADDR, &ns,
-		sizeof(ns), "__task_pid_nr_ns: ns", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_NSPROXY, nsproxy,
+		GCORE_OFFSET(nsproxy_pid_ns), &ns, sizeof(ns),
+		"__task_pid_nr_ns: ns", gcore_verbose_error_handle());
 
 	if (pid_alive(task)) {
 		ulong pids_type_pid, signal;
 
                 if (type != PIDTYPE_PID)
-			readmem(task + MEMBER_OFFSET("task_struct",
-						     "group_leader"),
-				KVADDR, &task, sizeof(ulong),
+			gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+				MEMBER_OFFSET("task_struct", "group_leader"),
+				&task, sizeof(ulong),
 				"__task_pid_nr_ns: group_leader",
 				gcore_verbose_error_handle());
 
 		if (VALID_MEMBER(task_struct_pids))
-			readmem(task + OFFSET(task_struct_pids) +
-				type * SIZE(pid_link) + OFFSET(pid_link_pid),
-				KVADDR, &pids_type_pid,
-				sizeof(pids_type_pid),
+			gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+				OFFSET(task_struct_pids) + type * SIZE(pid_link) +
+				OFFSET(pid_link_pid),
+				&pids_type_pid, sizeof(pids_type_pid),
 				"__task_pid_nr_ns: pids_type_pid",
 				gcore_verbose_error_handle());
 		else
 			if (type == PIDTYPE_PID)
-				readmem(task + GCORE_OFFSET(task_struct_thread_pid),
-					KVADDR, &pids_type_pid,
-					sizeof(pids_type_pid),
+				gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+					GCORE_OFFSET(task_struct_thread_pid),
+					&pids_type_pid, sizeof(pids_type_pid),
 					"__task_pid_nr_ns: pids_type_pid",
 					gcore_verbose_error_handle());
 			else {
-				readmem(task + OFFSET(task_struct_signal),
-					KVADDR, &signal,
+				gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+					OFFSET(task_struct_signal), &signal,
 					sizeof(signal),
 					"__task_pid_nr_ns: signal",
 					gcore_verbose_error_handle());
 
-				readmem(signal + GCORE_OFFSET(signal_struct_pids) +
+				gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+					GCORE_OFFSET(signal_struct_pids) +
 					type * sizeof(void *),
-					KVADDR, &pids_type_pid,
-					sizeof(pids_type_pid),
+					&pids_type_pid, sizeof(pids_type_pid),
 					"__task_pid_nr_ns: pids_type_pid",
 					gcore_verbose_error_handle());
 			}
@@ -292,26 +298,26 @@ thread_group_cputime_v0(ulong task, struct task_cputime *cputime)
 	ulong signal;
 	ulong utime, signal_utime, stime, signal_stime;
 
-	readmem(task + OFFSET(task_struct_signal), KVADDR, &signal,
-		sizeof(signal), "thread_group_cputime_v0: signal",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task, OFFSET(task_struct_signal),
+		&signal, sizeof(signal), "thread_group_cputime_v0: signal",
 		gcore_verbose_error_handle());
 
-	readmem(task + OFFSET(task_struct_utime), KVADDR, &utime,
-		sizeof(utime), "thread_group_cputime_v0: utime",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task, OFFSET(task_struct_utime),
+		&utime, sizeof(utime), "thread_group_cputime_v0: utime",
 		gcore_verbose_error_handle());
 
-	readmem(signal + GCORE_OFFSET(signal_struct_utime), KVADDR,
-		&signal_utime, sizeof(signal_utime),
-		"thread_group_cputime_v0: signal_utime",
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_utime), &signal_utime,
+		sizeof(signal_utime), "thread_group_cputime_v0: signal_utime",
 		gcore_verbose_error_handle());
 
-	readmem(task + OFFSET(task_struct_stime), KVADDR, &stime,
-		sizeof(stime), "thread_group_cputime_v0: stime",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task, OFFSET(task_struct_stime),
+		&stime, sizeof(stime), "thread_group_cputime_v0: stime",
 		gcore_verbose_error_handle());
 
-	readmem(signal + GCORE_OFFSET(signal_struct_stime), KVADDR,
-		&signal_stime, sizeof(signal_stime),
-		"thread_group_cputime_v0: signal_stime",
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_stime), &signal_stime,
+		sizeof(signal_stime), "thread_group_cputime_v0: signal_stime",
 		gcore_verbose_error_handle());
 
 	cputime->utime = utime + signal_utime;
@@ -329,35 +335,37 @@ thread_group_cputime_v22(ulong task, struct task_cputime *times)
 
 	*times = INIT_CPUTIME;
 
-	readmem(task + OFFSET(task_struct_sighand), KVADDR, &sighand,
-		sizeof(sighand), "thread_group_cputime_v22: sighand",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_sighand), &sighand, sizeof(sighand),
+		"thread_group_cputime_v22: sighand",
 		gcore_verbose_error_handle());
 
 	if (!sighand)
 		goto out;
 
-	readmem(task + OFFSET(task_struct_signal), KVADDR, &signal,
-		sizeof(signal), "thread_group_cputime_v22: signal",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task, OFFSET(task_struct_signal),
+		&signal, sizeof(signal), "thread_group_cputime_v22: signal",
 		gcore_verbose_error_handle());
 
-	FOR_EACH_TASK_IN_THREAD_GROUP(task_tgid(CURRENT_TASK()), tc) {
+	FOR_EACH_TASK_IN_THREAD_GROUP(gcore_task_tgid(CURRENT_CONTEXT()),
+				      tc) {
 		ulong utime, stime;
 		uint64_t sum_exec_runtime;
 
-		readmem(tc->task + OFFSET(task_struct_utime), KVADDR,
-			&utime,	sizeof(utime),
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			OFFSET(task_struct_utime), &utime, sizeof(utime),
 			"thread_group_cputime_v22: utime",
 			gcore_verbose_error_handle());
 
-		readmem(tc->task + OFFSET(task_struct_stime), KVADDR,
-			&stime, sizeof(stime),
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			OFFSET(task_struct_stime), &stime, sizeof(stime),
 			"thread_group_cputime_v22: stime",
 			gcore_verbose_error_handle());
 
-		readmem(tc->task + GCORE_OFFSET(task_struct_se) +
+		gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+			GCORE_OFFSET(task_struct_se) +
 			GCORE_OFFSET(sched_entity_sum_exec_runtime),
-			KVADDR,	&sum_exec_runtime,
-			sizeof(sum_exec_runtime),
+			&sum_exec_runtime, sizeof(sum_exec_runtime),
 			"thread_group_cputime_v22: sum_exec_runtime",
 			gcore_verbose_error_handle());
 
@@ -366,16 +374,19 @@ thread_group_cputime_v22(ulong task, struct task_cputime *times)
 		times->sum_exec_runtime += sum_exec_runtime;
 	}
 
-	readmem(signal + GCORE_OFFSET(signal_struct_utime), KVADDR,
-		&signal_utime, sizeof(signal_utime),
-		"thread_group_cputime_v22: signal_utime", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_utime), &signal_utime,
+		sizeof(signal_utime), "thread_group_cputime_v22: signal_utime",
+		gcore_verbose_error_handle());
 
-	readmem(signal + GCORE_OFFSET(signal_struct_stime), KVADDR,
-		&signal_stime, sizeof(signal_stime),
-		"thread_group_cputime_v22: signal_stime", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_stime), &signal_stime,
+		sizeof(signal_stime), "thread_group_cputime_v22: signal_stime",
+		gcore_verbose_error_handle());
 
-	readmem(signal + GCORE_OFFSET(signal_struct_sum_sched_runtime),
-		KVADDR, &sum_sched_runtime, sizeof(sum_sched_runtime),
+	gcore_objcache_readmem(GCORE_OBJ_SIGNAL, signal,
+		GCORE_OFFSET(signal_struct_sum_sched_runtime),
+		&sum_sched_runtime, sizeof(sum_sched_runtime),
 		"thread_group_cputime_v22: sum_sched_runtime",
 		gcore_verbose_error_handle());
 
@@ -392,8 +403,9 @@ task_uid_v0(ulong task)
 {
 	__kernel_uid_t uid;
 
-	readmem(task + GCORE_OFFSET(task_struct_uid), KVADDR, &uid,
-		sizeof(uid), "task_uid_v0: uid", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		GCORE_OFFSET(task_struct_uid), &uid, sizeof(uid),
+		"task_uid_v0: uid", gcore_verbose_error_handle());
 
 	return uid;
 }
@@ -404,11 +416,13 @@ task_uid_v28(ulong task)
 	ulong cred;
 	__kernel_uid_t uid;
 
-	readmem(task + GCORE_OFFSET(task_struct_real_cred), KVADDR, &cred,
-		sizeof(cred), "task_uid_v28: real_cred", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		GCORE_OFFSET(task_struct_real_cred), &cred, sizeof(cred),
+		"task_uid_v28: real_cred", gcore_verbose_error_handle());
 
-	readmem(cred + GCORE_OFFSET(cred_uid), KVADDR, &uid, sizeof(uid),
-		"task_uid_v28: uid", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_CRED, cred, GCORE_OFFSET(cred_uid),
+		&uid, sizeof(uid), "task_uid_v28: uid",
+		gcore_verbose_error_handle());
 
 	return uid;
 }
@@ -418,8 +432,9 @@ task_gid_v0(ulong task)
 {
 	__kernel_gid_t gid;
 
-	readmem(task + GCORE_OFFSET(task_struct_gid), KVADDR, &gid,
-		sizeof(gid), "task_gid_v0: gid", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		GCORE_OFFSET(task_struct_gid), &gid, sizeof(gid),
+		"task_gid_v0: gid", gcore_verbose_error_handle());
 
 	return gid;
 }
@@ -430,11 +445,13 @@ task_gid_v28(ulong task)
 	ulong cred;
 	__kernel_gid_t gid;
 
-	readmem(task + GCORE_OFFSET(task_struct_real_cred), KVADDR, &cred,
-		sizeof(cred), "task_gid_v28: real_cred", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		GCORE_OFFSET(task_struct_real_cred), &cred, sizeof(cred),
+		"task_gid_v28: real_cred", gcore_verbose_error_handle());
 
-	readmem(cred + GCORE_OFFSET(cred_gid), KVADDR, &gid, sizeof(gid),
-		"task_gid_v28: gid", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_CRED, cred, GCORE_OFFSET(cred_gid),
+		&gid, sizeof(gid), "task_gid_v28: gid",
+		gcore_verbose_error_handle());
 
 	return gid;
 }
@@ -445,16 +462,15 @@ pid_alive(ulong task)
 	pid_t pid;
 
 	if (VALID_MEMBER(task_struct_pids))
-		readmem(task + OFFSET(task_struct_pids) +
-			PIDTYPE_PID * SIZE(pid_link) + OFFSET(pid_link_pid),
-			KVADDR, &pid, sizeof(pid),
-			"pid_alive",
+		gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+			OFFSET(task_struct_pids) + PIDTYPE_PID * SIZE(pid_link) +
+			OFFSET(pid_link_pid),
+			&pid, sizeof(pid), "pid_alive",
 			gcore_verbose_error_handle());
 	else
-		readmem(task + GCORE_OFFSET(task_struct_thread_pid),
-			KVADDR, &pid, sizeof(pid),
-			"task_struct.thread_pid",
-			gcore_verbose_error_handle());
+		gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+			GCORE_OFFSET(task_struct_thread_pid), &pid, sizeof(pid),
+			"task_struct.thread_pid", gcore_verbose_error_handle());
 
         return !!pid;
 }
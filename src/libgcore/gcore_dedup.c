@@ -0,0 +1,326 @@
+/* gcore_dedup.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+#include <sys/syscall.h>
+
+/*
+ * Shared-page deduplication across the cores of one gcore command.
+ *
+ * Shared libraries, shared anonymous memory and pages inherited
+ * copy-on-write by forked processes map the same physical frames in
+ * every process. The first time such a frame is written into a core,
+ * its page frame number is recorded with the file and the offset it
+ * went to. When a later core of the same command needs the frame, it
+ * is copied from that file with copy_file_range() instead of being
+ * read from the dump again; on filesystems supporting reflinks, the
+ * cores then share the extent on disk.
+ *
+ * Only completed cores are used as sources: a core being written, or
+ * one that failed, is never copied from. Cores must be plain files,
+ * neither compressed nor streamed, on both sides.
+ *
+ * The index lives as long as the command, beyond the free_all_bufs()
+ * after each task, so it is allocated with malloc().
+ */
+
+struct gcore_dedup_entry
+{
+	ulong pfn;		/* ~0UL for an empty slot */
+	off_t offset;		/* -1 if the page could not be read */
+	int file;
+};
+
+struct gcore_dedup_file
+{
+	int fd;			/* -1 unless the core is complete */
+	char name[CORENAME_MAX_SIZE + 1];
+};
+
+struct gcore_dedup_data
+{
+	struct gcore_dedup_entry *table;
+	ulong size;		/* power of 2 */
+	ulong used;
+
+	struct gcore_dedup_file *files;
+	int nr_files;
+	int max_files;
+	int current;		/* file being written, or -1 */
+
+	char *bounce;		/* for copies without copy_file_range() */
+};
+
+static struct gcore_dedup_data gcore_dedup_data;
+static struct gcore_dedup_data *gdd = &gcore_dedup_data;
+
+static struct gcore_dedup_entry *dedup_slot(ulong pfn);
+static int dedup_grow(void);
+
+/**
+ * Drop the index and the cores of the previous command, if any.
+ */
+void gcore_dedup_set_default(void)
+{
+	int i;
+
+	for (i = 0; i < gdd->nr_files; i++)
+		if (gdd->files[i].fd >= 0)
+			close(gdd->files[i].fd);
+
+	free(gdd->table);
+	free(gdd->files);
+	free(gdd->bounce);
+	BZERO(gdd, sizeof(*gdd));
+	gdd->current = -1;
+}
+
+/**
+ * Register @writer, about to receive the core file @name, as the
+ * destination of the current session.
+ *
+ * Return Value:
+ *
+ *   TRUE if pages can be deduplicated into it; FALSE if dedup is not
+ *   requested or the output cannot take copied extents.
+ */
+int gcore_dedup_begin(struct gcore_writer *writer, const char *name)
+{
+	struct gcore_dedup_file *f;
+
+	gdd->current = -1;
+
+	if (!gcore_writer_dedup() || gcore_writer_fd(writer) < 0)
+		return FALSE;
+
+	if (gdd->nr_files == gdd->max_files) {
+		int max = gdd->max_files ? 2 * gdd->max_files : 16;
+
+		if (!(f = realloc(gdd->files, max * sizeof(*f))))
+			return FALSE;
+		gdd->files = f;
+		gdd->max_files = max;
+	}
+
+	if (!gdd->table && !dedup_grow())
+		return FALSE;
+
+	f = &gdd->files[gdd->nr_files];
+	f->fd = -1;
+	snprintf(f->name, sizeof(f->name), "%s", name);
+	gdd->current = gdd->nr_files++;
+
+	return TRUE;
+}
+
+/**
+ * Close the current session. If its core has been saved, it is opened
+ * again for reading, and pages recorded in it can be copied from now
+ * on; otherwise, they never will.
+ */
+void gcore_dedup_end(int saved)
+{
+	struct gcore_dedup_file *f;
+
+	if (gdd->current < 0)
+		return;
+
+	f = &gdd->files[gdd->current];
+	gdd->current = -1;
+
+	if (saved && (f->fd = open(f->name, O_RDONLY)) < 0)
+		error(WARNING, "%s: open: %s; not deduplicating from it\n",
+		      f->name, strerror(errno));
+}
+
+/**
+ * Return how many of the @nr_pages pages at @paddr, from the first on,
+ * can be copied from one earlier core, at consecutive offsets of it.
+ * Then *@fd and *@offset tell where the first page is.
+ */
+int gcore_dedup_find(physaddr_t *paddr, int nr_pages, int *fd, off_t *offset)
+{
+	struct gcore_dedup_entry *e;
+	int i;
+
+	if (!gdd->table)
+		return 0;
+
+	for (i = 0; i < nr_pages; i++) {
+		e = dedup_slot(BTOP(paddr[i]));
+		if (e->pfn == ~0UL || e->offset < 0 ||
+		    gdd->files[e->file].fd < 0)
+			break;
+		if (i == 0) {
+			*fd = gdd->files[e->file].fd;
+			*offset = e->offset;
+		} else if (gdd->files[e->file].fd != *fd ||
+			   e->offset != *offset + i * PAGE_SIZE)
+			break;
+	}
+
+	return i;
+}
+
+/**
+ * Record that the @nr_pages pages at @paddr are written at @offset of
+ * the current core. Pages already recorded keep their first location.
+ */
+void gcore_dedup_add(physaddr_t *paddr, int nr_pages, off_t offset)
+{
+	struct gcore_dedup_entry *e;
+	int i;
+
+	if (gdd->current < 0)
+		return;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (2 * (gdd->used + 1) > gdd->size && !dedup_grow())
+			return;
+
+		e = dedup_slot(BTOP(paddr[i]));
+		if (e->pfn != ~0UL && e->offset >= 0)
+			continue;
+
+		if (e->pfn == ~0UL)
+			gdd->used++;
+		e->pfn = BTOP(paddr[i]);
+		e->offset = offset + i * PAGE_SIZE;
+		e->file = gdd->current;
+	}
+}
+
+/**
+ * Take back the page at @paddr recorded in the current core, which
+ * could not be read and was left as a hole with -o tolerant, so that
+ * later cores read it again instead of copying zeros.
+ */
+void gcore_dedup_forget(physaddr_t paddr)
+{
+	struct gcore_dedup_entry *e;
+
+	if (gdd->current < 0 || !gdd->table)
+		return;
+
+	e = dedup_slot(BTOP(paddr));
+	if (e->pfn == BTOP(paddr) && e->file == gdd->current)
+		e->offset = -1;
+}
+
+/**
+ * Copy @len bytes at @src of @src_fd to @dst of @dst_fd, sharing the
+ * extents if the filesystem can.
+ *
+ * Return Value:
+ *
+ *   TRUE on success; FALSE with errno set on failure.
+ */
+int gcore_dedup_copy(int src_fd, off_t src, int dst_fd, off_t dst, size_t len)
+{
+#ifdef SYS_copy_file_range
+	while (len > 0) {
+		loff_t in = src, out = dst;
+		long n;
+
+		n = syscall(SYS_copy_file_range, src_fd, &in, dst_fd, &out,
+			    len, 0);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+		src += n;
+		dst += n;
+		len -= n;
+	}
+#endif
+
+	/* Across filesystems, or without copy_file_range(). */
+	if (len && !gdd->bounce &&
+	    !(gdd->bounce = malloc(GCORE_COPY_BATCH_PAGES * PAGE_SIZE)))
+		return FALSE;
+
+	while (len > 0) {
+		ssize_t n, w;
+
+		n = pread(src_fd, gdd->bounce,
+			  MIN(len, GCORE_COPY_BATCH_PAGES * PAGE_SIZE), src);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (!n)
+				errno = EIO;
+			return FALSE;
+		}
+
+		for (w = 0; w < n;) {
+			ssize_t m = pwrite(dst_fd, gdd->bounce + w, n - w,
+					   dst + w);
+
+			if (m < 0) {
+				if (errno == EINTR)
+					continue;
+				return FALSE;
+			}
+			w += m;
+		}
+
+		src += n;
+		dst += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Return the slot of @pfn, or the empty slot where it would go.
+ */
+static struct gcore_dedup_entry *dedup_slot(ulong pfn)
+{
+	ulong i = (pfn * 0x9E3779B97F4A7C15ULL) & (gdd->size - 1);
+
+	while (gdd->table[i].pfn != ~0UL && gdd->table[i].pfn != pfn)
+		i = (i + 1) & (gdd->size - 1);
+
+	return &gdd->table[i];
+}
+
+/*
+ * Double the hash table, keeping it at most half full.
+ */
+static int dedup_grow(void)
+{
+	struct gcore_dedup_entry *old = gdd->table, *table;
+	ulong i, size = gdd->size ? 2 * gdd->size : 1UL << 16;
+
+	if (!(table = malloc(size * sizeof(*table))))
+		return FALSE;
+	for (i = 0; i < size; i++)
+		table[i].pfn = ~0UL;
+
+	gdd->table = table;
+	gdd->size = size;
+
+	if (old) {
+		for (i = 0; i < size / 2; i++)
+			if (old[i].pfn != ~0UL)
+				*dedup_slot(old[i].pfn) = old[i];
+		free(old);
+	}
+
+	return TRUE;
+}
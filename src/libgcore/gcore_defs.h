@@ -170,6 +170,14 @@
 #define NT_FILE 0x46494c45
 #endif
 
+/*
+ * With -o tolerant, the address ranges of pages that could not be read
+ * from the dump are listed in a note named "GCORE" of this type, as
+ * pairs of 64-bit start and end addresses, in a PT_NOTE segment after
+ * the data.
+ */
+#define NT_GCORE_BAD_RANGES 1
+
 #define PAGE_ALIGN(X) roundup(X, ELF_EXEC_PAGESIZE)
 
 #ifdef divideup
@@ -330,6 +338,8 @@ extern void gcore_default_regsets_init(void);
 #endif
 
 extern int gcore_arch_get_fp_valid(struct task_context *tc);
+extern ulong gcore_arch_user_regs(struct task_context *tc);
+extern ulong gcore_arch_fpu_area(struct task_context *tc);
 
 /*
  * gcore_dumpfilter.c
@@ -367,12 +377,27 @@ extern ulong gcore_dumpfilter_vma_dump_size(ulong vma);
 #define VERBOSE_PROGRESS  0x1
 #define VERBOSE_NONQUIET  0x2
 #define VERBOSE_PAGEFAULT 0x4
+#define VERBOSE_STATS     0x8
+#define VERBOSE_STATS_JSON 0x10
 #define VERBOSE_DEFAULT_LEVEL VERBOSE_PAGEFAULT
 #define VERBOSE_MAX_LEVEL (VERBOSE_PROGRESS + VERBOSE_NONQUIET + \
-			   VERBOSE_PAGEFAULT)
+			   VERBOSE_PAGEFAULT + VERBOSE_STATS + \
+			   VERBOSE_STATS_JSON)
 
 #define VERBOSE_DEFAULT_ERROR_HANDLE (FAULT_ON_ERROR | QUIET)
 
+/*
+ * How page faults met while copying memory are reported, with
+ * VERBOSE_PAGEFAULT: contiguous pages as one range, up to a number of
+ * lines per core; only the number of pages and ranges; or one line per
+ * page.
+ */
+#define GCORE_FAULTS_RANGES  0
+#define GCORE_FAULTS_SUMMARY 1
+#define GCORE_FAULTS_PAGES   2
+
+#define GCORE_FAULTS_DEFAULT_LINES 64
+
 /*
  * Verbose flag is set each time gcore is executed. The same verbose
  * flag value is used for all the tasks given together in the command
@@ -406,6 +431,20 @@ extern ulong gcore_verbose_get(void);
  */
 extern ulong gcore_verbose_error_handle(void);
 
+/**
+ * gcore_verbose_set_faults() - set how page faults are reported
+ *
+ * @mode "ranges[:N]", "summary" or "pages", as given to --faults.
+ *
+ * Return FALSE if @mode is invalid.
+ */
+extern int gcore_verbose_set_faults(char *mode);
+
+extern void gcore_pagefault_init(void);
+extern void gcore_pagefault(ulong addr, ulong nr_pages);
+extern void gcore_pagefault_flush(void);
+extern void gcore_pagefault_report(void);
+
 /*
  * Helper printing functions for respective verbose flags
  */
@@ -444,6 +483,54 @@ extern ulong gcore_verbose_error_handle(void);
  */
 #define pagefaultf(...) verbosef(VERBOSE_PAGEFAULT, WARNING, __VA_ARGS__)
 
+/*
+ * Phase timing and counters of one core, printed after it is written
+ * as a table with VERBOSE_STATS, and as one JSON line with
+ * VERBOSE_STATS_JSON. Phases may nest: regsets is part of notes.
+ */
+enum gcore_phase {
+	GCORE_PHASE_VMAS,	/* VMA walk and segment layout */
+	GCORE_PHASE_OPEN,
+	GCORE_PHASE_ELF_HEADER,
+	GCORE_PHASE_NOTES,
+	GCORE_PHASE_REGSETS,	/* regset callbacks, per thread */
+	GCORE_PHASE_PHDRS,	/* PT_NOTE and PT_LOAD program headers */
+	GCORE_PHASE_COPY,	/* PT_LOAD data */
+	GCORE_PHASE_NR
+};
+
+enum gcore_counter {
+	GCORE_COUNT_READMEM,
+	GCORE_COUNT_UVTOP,
+	GCORE_COUNT_NR
+};
+
+extern void gcore_stats_init(void);
+extern void gcore_phase_begin(int phase);
+extern void gcore_phase_end(int phase);
+extern void gcore_stats_report(void);
+
+extern ulong gcore_counters[GCORE_COUNT_NR];
+
+/*
+ * readmem() and uvtop() counting their calls, used where the number of
+ * calls grows with the size of the process: the copy engine, the page
+ * table walker, the object cache and the maple tree walk.
+ */
+static inline int gcore_readmem(ulonglong addr, int memtype, void *buffer,
+				long size, char *type, ulong error_handle)
+{
+	gcore_counters[GCORE_COUNT_READMEM]++;
+	return readmem(addr, memtype, buffer, size, type, error_handle);
+}
+
+static inline int gcore_uvtop(struct task_context *tc, ulong vaddr,
+			      physaddr_t *paddr, int verbose)
+{
+	gcore_counters[GCORE_COUNT_UVTOP]++;
+	return uvtop(tc, vaddr, paddr, verbose);
+}
+
 /*
  * gcore_x86.c
  */
@@ -678,6 +765,180 @@ extern ulong gcore_arch_get_gate_vma(void);
 extern char *gcore_arch_vma_name(ulong vma);
 extern int gcore_arch_vsyscall_has_vm_alwaysdump_flag(void);
 
+/*
+ * gcore_writer.c
+ */
+#define GCORE_WRITER_DEFAULT_BUFSIZE (1UL << 20)
+#define GCORE_WRITER_MAX_BUFSIZE (1UL << 30)
+#define GCORE_WRITER_URING_DEPTH 4
+#define GCORE_WRITER_URING_MAX_DEPTH 32
+#define GCORE_WRITER_TRIM_GAP (1UL << 20)
+
+struct gcore_uring;
+struct gcore_compress;
+
+/*
+ * A compressed core file is made of independent frames; a frame is
+ * recorded here for the seek table written on close.
+ */
+struct gcore_writer_frame
+{
+	uint32_t compressed;	/* size of the frame in the file */
+	uint32_t decompressed;	/* bytes of the core file it holds */
+};
+
+struct gcore_writer_buffer
+{
+	char *data;		/* page-aligned, bufsize bytes */
+	int busy;		/* write in flight */
+	int fd;
+	size_t len;
+	off_t offset;
+};
+
+struct gcore_writer
+{
+	int fd;
+	int direct_fd;		/* opened with O_DIRECT, or -1 */
+	struct gcore_uring *uring;
+	struct gcore_writer_buffer bufs[GCORE_WRITER_URING_MAX_DEPTH];
+	int nbufs;
+	int cur;		/* index of buf in bufs */
+	char *buf;		/* current output buffer */
+	size_t bufsize;
+	size_t len;		/* bytes buffered */
+	off_t pos;		/* file offset of buf[0] */
+	off_t end;		/* logical file size, holes included */
+	ulong writes;		/* write system calls issued */
+	ulong direct_writes;	/* of which with O_DIRECT */
+	ulonglong bytes;	/* bytes written */
+
+	/*
+	 * Compressed output. Until gcore_writer_begin_data(), everything
+	 * is written into the head image; after that, the position only
+	 * moves forward and each buffer flush emits one frame at zpos.
+	 */
+	struct gcore_compress *compress;
+	int staging;
+	char *head;		/* image of [0, head_size) */
+	size_t head_size;
+	char *zbuf;		/* one compressed frame */
+	size_t zbufsize;
+	off_t zpos;		/* file offset of the next frame */
+	struct gcore_writer_frame *frames;
+	ulong nr_frames;
+	ulong max_frames;
+
+	/*
+	 * Streamed output, to a pipe for example, is staged like
+	 * compressed output and then written with write() only.
+	 */
+	int stream;
+};
+
+/*
+ * Output options are set each time gcore is executed, like the verbose
+ * level, and are used for all the tasks given together in the command
+ * line.
+ */
+extern void gcore_writer_set_default(void);
+extern int gcore_writer_set(char *options);
+extern int gcore_writer_parse_size(char *s, ulong *size);
+
+extern struct gcore_writer *gcore_writer_open(const char *path);
+extern int gcore_writer_write(struct gcore_writer *w, const void *buf,
+			      size_t len);
+extern int gcore_writer_skip(struct gcore_writer *w, off_t len);
+extern int gcore_writer_seek(struct gcore_writer *w, off_t offset);
+extern off_t gcore_writer_tell(struct gcore_writer *w);
+extern int gcore_writer_pwrite(struct gcore_writer *w, const void *buf,
+			       size_t len, off_t offset);
+extern int gcore_writer_flush(struct gcore_writer *w);
+extern int gcore_writer_begin_data(struct gcore_writer *w);
+extern const char *gcore_writer_suffix(void);
+extern const char *gcore_writer_stream_path(void);
+extern ulong gcore_writer_trim_gap(void);
+extern int gcore_writer_dedup(void);
+extern int gcore_writer_resume(void);
+extern int gcore_writer_tolerant(void);
+extern int gcore_writer_fd(struct gcore_writer *w);
+extern int gcore_writer_close(struct gcore_writer *w);
+extern ulonglong gcore_writer_bytes(struct gcore_writer *w);
+extern void gcore_writer_report(struct gcore_writer *w);
+
+/*
+ * gcore_journal.c
+ *
+ * Progress is recorded about every GCORE_JOURNAL_INTERVAL bytes of the
+ * core file.
+ */
+#define GCORE_JOURNAL_INTERVAL (1UL << 30)
+
+extern void gcore_journal_open(const char *corename);
+extern int gcore_journal_resuming(void);
+extern void gcore_journal_begin_data(struct gcore_writer *writer,
+				     off_t data_offset, ulong *segment,
+				     ulong *vaddr);
+extern int gcore_journal_active(void);
+extern void gcore_journal_checkpoint(ulong segment, ulong vaddr);
+extern void gcore_journal_close(int saved);
+
+/*
+ * gcore_dedup.c
+ *
+ * The index of pages written is kept across all the tasks given to
+ * one gcore command.
+ */
+extern void gcore_dedup_set_default(void);
+extern int gcore_dedup_begin(struct gcore_writer *writer, const char *name);
+extern void gcore_dedup_end(int saved);
+extern int gcore_dedup_find(physaddr_t *paddr, int nr_pages, int *fd,
+			    off_t *offset);
+extern void gcore_dedup_add(physaddr_t *paddr, int nr_pages, off_t offset);
+extern void gcore_dedup_forget(physaddr_t paddr);
+extern int gcore_dedup_copy(int src_fd, off_t src, int dst_fd, off_t dst,
+			    size_t len);
+
+/*
+ * gcore_compress.c
+ */
+enum gcore_compress_codec_id {
+	GCORE_COMPRESS_NONE,
+	GCORE_COMPRESS_ZSTD,
+	GCORE_COMPRESS_LZ4,
+	GCORE_COMPRESS_GZIP,
+	GCORE_COMPRESS_NR_CODECS
+};
+
+/*
+ * The seek table appended to zstd and lz4 core files follows the zstd
+ * seekable format: a skippable frame holding one little-endian
+ * gcore_writer_frame per frame, then this footer.
+ */
+#define GCORE_SKIPPABLE_MAGIC 0x184D2A5E
+#define GCORE_SEEKABLE_MAGIC 0x8F92EAB1
+
+extern int gcore_compress_lookup(const char *name);
+extern int gcore_compress_available(int codec);
+extern const char *gcore_compress_suffix(int codec);
+extern struct gcore_compress *gcore_compress_init(int codec, int level,
+						  int threads);
+extern int gcore_compress_seekable(struct gcore_compress *c);
+extern size_t gcore_compress_bound(struct gcore_compress *c, size_t len);
+extern size_t gcore_compress_frame(struct gcore_compress *c, void *dst,
+				   size_t size, const void *src, size_t len);
+extern void gcore_compress_exit(struct gcore_compress *c);
+
+/*
+ * gcore_uring.c
+ */
+extern struct gcore_uring *gcore_uring_init(unsigned entries);
+extern unsigned gcore_uring_space(struct gcore_uring *r);
+extern int gcore_uring_write(struct gcore_uring *r, int fd, const void *buf,
+			     size_t len, off_t offset, ulong data);
+extern int gcore_uring_wait(struct gcore_uring *r, ulong *data, int *res);
+extern void gcore_uring_exit(struct gcore_uring *r);
+
 /*
  * gcore_coredump_table.c
  */
@@ -688,6 +949,143 @@ extern void gcore_coredump_table_init(void);
  */
 extern void gcore_coredump(void);
 
+/*
+ * gcore_maple.c
+ */
+extern int gcore_maple_vma_tree(void);
+extern ulong gcore_maple_first_vma(ulong mt);
+extern ulong gcore_maple_next_vma(ulong vma);
+
+/*
+ * gcore_objcache.c
+ */
+enum gcore_objcache_type {
+	GCORE_OBJ_TASK,
+	GCORE_OBJ_SIGNAL,
+	GCORE_OBJ_CRED,
+	GCORE_OBJ_NSPROXY,
+	GCORE_OBJ_PID,
+	GCORE_OBJ_PID_NS,
+	GCORE_OBJ_PT_REGS,	/* user registers saved at the stack top */
+	GCORE_OBJ_FPU,		/* FPU state kept outside task_struct */
+	GCORE_OBJ_NR_TYPES
+};
+
+#define GCORE_OBJCACHE_MAX_BYTES (256UL << 20)
+
+struct gcore_objcache_stats
+{
+	ulong fields;	/* field reads requested */
+	ulong objects;	/* objects read whole */
+	ulong uncached;	/* field reads passed to readmem() */
+	ulong prefetched;	/* objects read ahead in parallel */
+};
+
+extern void gcore_objcache_table_init(void);
+extern void gcore_objcache_set_size(int type, long size);
+extern void gcore_objcache_init(void);
+extern int gcore_objcache_readmem(int type, ulong obj, long offset,
+				  void *buffer, long size, char *type_string,
+				  ulong error_handle);
+extern void gcore_objcache_prefetch(int type, ulong *objs, int nr);
+extern const struct gcore_objcache_stats *gcore_objcache_get_stats(void);
+extern void gcore_objcache_report(void);
+
+/*
+ * gcore_copy.c
+ */
+#define GCORE_COPY_BATCH_PAGES 512 /* a 2MB huge page on x86_64 */
+
+struct gcore_copy_stats
+{
+	ulong pages;	/* pages processed */
+	ulong present;	/* pages read from the dump */
+	ulong faulted;	/* page-faulted pages left as holes */
+	ulong translations; /* virtual-to-physical translations */
+	ulong huge;	/* translations hitting a huge page */
+	ulong reads;	/* readmem() calls issued */
+	ulong writes;	/* write calls issued */
+	ulong holes;	/* runs of page-faulted pages skipped */
+	ulong zero;	/* pages read but found all zeros, not written */
+	ulong zero_pfn;	/* pages mapping the zero page, not read */
+	ulong dedup;	/* pages copied from earlier cores, not read */
+	ulong bad;	/* unreadable pages left as holes, with -o tolerant */
+	ulong excluded;	/* pages excluded from the dump file, not read */
+};
+
+extern void gcore_copy_scan_init(void);
+extern ulong gcore_copy_scan(ulong addr, ulong end, int present);
+extern ulong gcore_copy_recoverable(ulong start, ulong end);
+extern void gcore_copy_init(void);
+extern void gcore_copy_range(ulong start, ulong end);
+extern void gcore_copy_skip(ulong len);
+extern void gcore_copy_sync(void);
+extern ulong gcore_copy_get_bad_ranges(ulong **ranges);
+extern void gcore_copy_finish(void);
+extern const struct gcore_copy_stats *gcore_copy_get_stats(void);
+extern void gcore_copy_report(void);
+extern int gcore_page_is_zero(const void *page);
+
+/**
+ * gcore_arch_vtop_init() - set up the page-table walker
+ * gcore_arch_vtop() - translate a user virtual address
+ *
+ * These are defined as weak symbols: gcore_arch_vtop_init() returns
+ * FALSE by default, and then the copy engine uses uvtop() instead.
+ */
+extern int gcore_arch_vtop_init(void);
+extern int gcore_arch_vtop(ulong vaddr, physaddr_t *paddr, ulong *size);
+
+/*
+ * gcore_bitmap.c
+ */
+extern int gcore_bitmap_active(void);
+extern int gcore_bitmap_excluded(physaddr_t paddr);
+extern int gcore_kdump_active(void);
+extern size_t gcore_kdump_scratch_size(void);
+extern int gcore_kdump_readable(physaddr_t paddr, ulong len);
+extern int gcore_kdump_read(int fd, physaddr_t paddr, char *buf, ulong len,
+			    char *scratch);
+
+/*
+ * gcore_copy_parallel.c
+ */
+#define GCORE_PARALLEL_MAX_THREADS 64
+#define GCORE_PARALLEL_QUEUE_SIZE 256
+
+/*
+ * The number of copy threads is set each time gcore is executed, like
+ * the verbose level, and is used for all the tasks given together in
+ * the command line.
+ */
+extern void gcore_parallel_set_default(void);
+extern int gcore_parallel_set(ulong threads);
+extern ulong gcore_parallel_get(void);
+extern int gcore_parallel_start(int core_fd);
+extern int gcore_parallel_submit(ulong vaddr, physaddr_t paddr, ulong len,
+				 off_t dst);
+extern int gcore_parallel_drain(void);
+extern int gcore_parallel_finish(void);
+extern ulong gcore_parallel_zero_pages(void);
+
+struct gcore_parallel_bad
+{
+	ulong vaddr;
+	physaddr_t paddr;
+};
+
+extern ulong gcore_parallel_bad_pages(struct gcore_parallel_bad **pages);
+
+struct gcore_parallel_read
+{
+	physaddr_t paddr;
+	size_t len;
+	void *buf;
+	int done;
+};
+
+extern int gcore_parallel_read(struct gcore_parallel_read *reads, int nr);
+
 /*
  * gcore_global_data.c
  */
@@ -1007,21 +1405,31 @@ struct elf_note_info {
 #define VM_ALWAYSDUMP   (gcore_machdep->vm_alwaysdump)
                                         /* Always include in core dumps */
 
+/*
+ * @mmap is the head of the mm_struct.mmap list, or the address of
+ * mm_struct.mm_mt on kernels keeping VMAs in a maple tree; see
+ * gcore_mm_vmas().
+ */
 extern ulong first_vma(ulong mmap, ulong gate_vma);
 extern ulong next_vma(ulong this_vma, ulong gate_vma);
+extern ulong gcore_mm_vmas(ulong mm, char *mm_cache);
 
 #define FOR_EACH_VMA_OBJECT(vma, index, mmap, gate_vma)			\
 	for (index = 0, vma = first_vma(mmap, gate_vma); vma;		\
 	     ++index, vma = next_vma(vma, gate_vma))
 
+/*
+ * Thread groups are looked up in an index of the task table, built on
+ * first use and kept until gcore_thread_group_reset() at the end of
+ * the command, so that iterating over a group costs O(threads in the
+ * group) instead of O(tasks in the system).
+ */
+extern void gcore_thread_group_reset(void);
+extern ulong gcore_task_tgid(struct task_context *tc);
+extern struct task_context *first_task_context(ulong tgid);
 extern struct task_context *
 next_task_context(ulong tgid, struct task_context *tc);
 
-static inline struct task_context *first_task_context(ulong tgid)
-{
-	return next_task_context(tgid, FIRST_CONTEXT());
-}
-
 #define FOR_EACH_TASK_IN_THREAD_GROUP(tgid, tc)				\
 	for (tc = first_task_context(tgid); tc;				\
 	     tc = next_task_context(tgid, tc))
@@ -1057,6 +1465,9 @@ struct gcore_offset_table
 	long desc_struct_base2;
 	long fpu_state;
 	long inode_i_nlink;
+	long maple_arange_64_pivot;
+	long maple_range_64_pivot;
+	long maple_tree_ma_root;
 	long nsproxy_pid_ns;
 	long mm_context_t_vdso;
 	long mm_struct_arg_start;
@@ -1066,6 +1477,7 @@ struct gcore_offset_table
 	long mm_struct_saved_auxv;
 	long mm_struct_saved_files;
 	long mm_struct_context;
+	long mm_struct_mm_mt;
 	long pid_level;
 	long pid_namespace_level;
 	long pt_regs_ax;
@@ -1138,6 +1550,9 @@ struct gcore_offset_table
 
 struct gcore_size_table
 {
+	long maple_arange_64_pivot;
+	long maple_node;
+	long maple_range_64_pivot;
 	long mm_context_t;
 	long mm_struct_saved_auxv;
 	long mm_struct_saved_files;
@@ -1214,18 +1629,24 @@ struct gcore_elf_operations
 	 * A set of helper functions to perform write operation for
 	 * respective ELF data structures.
 	 *
-	 *  @fd file descripter for a generated core dump file.
+	 *  @writer writer for a generated core dump file.
+	 *
+	 * - The ELF header and the section header are written at
+	 *   their fixed offsets; the others at the current position.
 	 *
 	 * - Return TRUE if write operation is successfully
 	 *   done. Otherwise, return FALSE.
 	 *
 	 * - No exception is raised.
 	 */
-	int (*write_elf_header)(struct gcore_elf_struct *this, FILE *fp);
-	int (*write_section_header)(struct gcore_elf_struct *this, FILE *fp);
-	int (*write_program_header)(struct gcore_elf_struct *this, FILE *fp);
-	int (*write_note_header)(struct gcore_elf_struct *this, FILE *fp,
-				 off_t *offset);
+	int (*write_elf_header)(struct gcore_elf_struct *this,
+				struct gcore_writer *writer);
+	int (*write_section_header)(struct gcore_elf_struct *this,
+				    struct gcore_writer *writer);
+	int (*write_program_header)(struct gcore_elf_struct *this,
+				    struct gcore_writer *writer);
+	int (*write_note_header)(struct gcore_elf_struct *this,
+				 struct gcore_writer *writer, off_t *offset);
 
 	uint64_t (*get_e_phoff)(struct gcore_elf_struct *this);
 	uint64_t (*get_e_shoff)(struct gcore_elf_struct *this);
@@ -1260,13 +1681,49 @@ extern void gcore_elf_init(struct gcore_one_session_data *gcore);
  * task2. Session for task1 is not used for task2; all fields of which
  * is initialized at the beginning of dump processing for task2.
  */
+/*
+ * One PT_LOAD segment. A VMA usually makes one segment; with -o trim,
+ * its page-faulted tail is left out of p_filesz and it is split around
+ * large page-faulted gaps, which then lie beyond p_filesz.
+ */
+struct gcore_segment
+{
+	ulong vaddr;
+	ulong filesz;
+	ulong memsz;
+	uint32_t flags;		/* PF_* */
+	loff_t offset;		/* in the core file */
+};
+
+/*
+ * One record per VMA of the dump task, gate_vma included, collected in
+ * a single walk of the VMA list. The PT_LOAD layout and the NT_FILE
+ * note then run over this table rather than over the list.
+ */
+struct gcore_vma
+{
+	ulong vma;		/* vm_area_struct */
+	ulong start;
+	ulong end;
+	ulong flags;		/* vm_flags */
+	ulong file;
+	ulong pgoff;
+	ulong dump_size;
+	uint32_t p_flags;	/* PF_* */
+};
+
 struct gcore_one_session_data
 {
 	ulong flags;
-	FILE *fp;
+	struct gcore_writer *writer;
 	ulong orig_task;
 	char corename[CORENAME_MAX_SIZE + 1];
 	struct gcore_elf_struct *elf;
+	struct gcore_vma *vmas;
+	ulong nr_vmas;
+	struct gcore_segment *segments;
+	ulong nr_segments;
+	ulong max_segments;
 };
 
 static inline void gcore_arch_table_init(void)
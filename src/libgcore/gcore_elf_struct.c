@@ -110,42 +110,46 @@ elf64_fill_note_header(struct gcore_elf_struct *this, uint32_t n_namesz,
 	n->n_type = n_type;
 }
 
-static int elf64_write_elf_header(struct gcore_elf_struct *this, FILE *fp)
+static int elf64_write_elf_header(struct gcore_elf_struct *this,
+				  struct gcore_writer *writer)
 {
 	Elf64_Ehdr *e = &((struct gcore_elf64_struct *)this)->ehdr;
 
-	if (fwrite(e, sizeof(*e), 1, fp) != 1)
+	if (!gcore_writer_pwrite(writer, e, sizeof(*e), 0))
 		return FALSE;
 
 	return TRUE;
 }
 
-static int elf64_write_section_header(struct gcore_elf_struct *this, FILE *fp)
+static int elf64_write_section_header(struct gcore_elf_struct *this,
+				      struct gcore_writer *writer)
 {
+	Elf64_Ehdr *e = &((struct gcore_elf64_struct *)this)->ehdr;
 	Elf64_Shdr *s = &((struct gcore_elf64_struct *)this)->shdr;
 
-	if (fwrite(s, sizeof(*s), 1, fp) != 1)
+	if (!gcore_writer_pwrite(writer, s, sizeof(*s), e->e_shoff))
 		return FALSE;
 
 	return TRUE;
 }
 
-static int elf64_write_program_header(struct gcore_elf_struct *this, FILE *fp)
+static int elf64_write_program_header(struct gcore_elf_struct *this,
+				      struct gcore_writer *writer)
 {
 	Elf64_Phdr *p = &((struct gcore_elf64_struct *)this)->phdr;
 
-	if (fwrite(p, sizeof(*p), 1, fp) != 1)
+	if (!gcore_writer_write(writer, p, sizeof(*p)))
 		return FALSE;
 
 	return TRUE;
 }
 
-static int elf64_write_note_header(struct gcore_elf_struct *this, FILE *fp,
-				   off_t *offset)
+static int elf64_write_note_header(struct gcore_elf_struct *this,
+				   struct gcore_writer *writer, off_t *offset)
 {
 	Elf64_Nhdr *n = &((struct gcore_elf64_struct *)this)->nhdr;
 
-	if (fwrite(n, sizeof(*n), 1, fp) != 1)
+	if (!gcore_writer_write(writer, n, sizeof(*n)))
 		return FALSE;
 
 	*offset += sizeof(*n);
@@ -283,42 +287,46 @@ elf32_fill_note_header(struct gcore_elf_struct *this, uint32_t n_namesz,
 	n->n_type = n_type;
 }
 
-static int elf32_write_elf_header(struct gcore_elf_struct *this, FILE *fp)
+static int elf32_write_elf_header(struct gcore_elf_struct *this,
+				  struct gcore_writer *writer)
 {
 	Elf32_Ehdr *e = &((struct gcore_elf32_struct *)this)->ehdr;
 
-	if (fwrite(e, sizeof(*e), 1, fp) != 1)
+	if (!gcore_writer_pwrite(writer, e, sizeof(*e), 0))
 		return FALSE;
 
 	return TRUE;
 }
 
-static int elf32_write_section_header(struct gcore_elf_struct *this, FILE *fp)
+static int elf32_write_section_header(struct gcore_elf_struct *this,
+				      struct gcore_writer *writer)
 {
+	Elf32_Ehdr *e = &((struct gcore_elf32_struct *)this)->ehdr;
 	Elf32_Shdr *s = &((struct gcore_elf32_struct *)this)->shdr;
 
-	if (fwrite(s, sizeof(*s), 1, fp) != 1)
+	if (!gcore_writer_pwrite(writer, s, sizeof(*s), e->e_shoff))
 		return FALSE;
 
 	return TRUE;
 }
 
-static int elf32_write_program_header(struct gcore_elf_struct *this, FILE *fp)
+static int elf32_write_program_header(struct gcore_elf_struct *this,
+				      struct gcore_writer *writer)
 {
 	Elf32_Phdr *p = &((struct gcore_elf32_struct *)this)->phdr;
 
-	if (fwrite(p, sizeof(*p), 1, fp) != 1)
+	if (!gcore_writer_write(writer, p, sizeof(*p)))
 		return FALSE;
 
 	return TRUE;
 }
 
-static int elf32_write_note_header(struct gcore_elf_struct *this, FILE *fp,
-				   off_t *offset)
+static int elf32_write_note_header(struct gcore_elf_struct *this,
+				   struct gcore_writer *writer, off_t *offset)
 {
 	Elf32_Nhdr *n = &((struct gcore_elf32_struct *)this)->nhdr;
 
-	if (fwrite(n, sizeof(*n), 1, fp) != 1)
+	if (!gcore_writer_write(writer, n, sizeof(*n)))
 		return FALSE;
 
 	*offset += sizeof(*n);
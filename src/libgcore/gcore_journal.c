@@ -0,0 +1,302 @@
+/* gcore_journal.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+#include <stddef.h>
+
+/*
+ * Resumable core extraction.
+ *
+ * With -o resume, the progress of the data copy is recorded in a
+ * sidecar journal, <core>.journal, about every GCORE_JOURNAL_INTERVAL
+ * bytes of the core file, once the data before that point is on disk.
+ * The journal is only created once the data copy starts, and is
+ * removed when the core is saved.
+ *
+ * If gcore is run again on the same process after a failure, the core
+ * file is opened without being truncated, and everything up to the
+ * data is written again as usual. These headers and notes are then
+ * compared with the hash of those the journal was written for: if
+ * they match, the layout is the same, the core is truncated to the
+ * last recorded point and copying goes on from there; otherwise, the
+ * copy starts over.
+ */
+
+#define GCORE_JOURNAL_MAGIC	0x4A524347	/* "GCRJ" */
+#define GCORE_JOURNAL_VERSION	1
+
+struct gcore_journal_record
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t layout;	/* hash of [0, data_offset) of the core */
+	uint64_t data_offset;
+	uint64_t segment;	/* PT_LOAD being copied */
+	uint64_t vaddr;		/* next address to copy in it */
+	uint64_t offset;	/* core file offset of vaddr */
+	uint64_t checksum;	/* of the fields above */
+};
+
+struct gcore_journal_data
+{
+	int fd;			/* -1 unless the journal is open */
+	int enabled;		/* -o resume is in effect for this core */
+	int resuming;		/* a valid record has been read */
+	struct gcore_journal_record rec;
+	char name[CORENAME_MAX_SIZE + sizeof(".journal")];
+};
+
+static struct gcore_journal_data gcore_journal_data = { .fd = -1 };
+static struct gcore_journal_data *gjd = &gcore_journal_data;
+
+static uint64_t journal_hash(const void *buf, size_t len, uint64_t hash);
+static int journal_hash_file(int fd, off_t len, uint64_t *hash);
+static int journal_write(void);
+
+/**
+ * If -o resume is given, open the journal an earlier run has left for
+ * the core file @corename, if any, and read the progress recorded in
+ * it. No journal is created here.
+ */
+void gcore_journal_open(const char *corename)
+{
+	struct gcore_journal_record *r = &gjd->rec;
+
+	gcore_journal_close(FALSE);
+
+	if (!gcore_writer_resume())
+		return;
+
+	gjd->enabled = TRUE;
+	snprintf(gjd->name, sizeof(gjd->name), "%s.journal", corename);
+
+	if ((gjd->fd = open(gjd->name, O_RDWR)) < 0) {
+		if (errno != ENOENT)
+			error(WARNING, "%s: open: %s\n", gjd->name,
+			      strerror(errno));
+		return;
+	}
+
+	if (pread(gjd->fd, r, sizeof(*r), 0) == sizeof(*r) &&
+	    r->magic == GCORE_JOURNAL_MAGIC &&
+	    r->version == GCORE_JOURNAL_VERSION &&
+	    r->checksum == journal_hash(r, offsetof(struct
+				gcore_journal_record, checksum), 0))
+		gjd->resuming = TRUE;
+}
+
+/**
+ * Return TRUE if an earlier run of this core has left a journal, so
+ * that the core file must not be truncated on open.
+ */
+int gcore_journal_resuming(void)
+{
+	return gjd->fd >= 0 && gjd->resuming;
+}
+
+/**
+ * gcore_journal_begin_data - validate the journal and find where to
+ *                            resume the copy
+ *
+ * @writer       writer of the core, positioned at @data_offset
+ * @data_offset  core file offset of the first PT_LOAD segment
+ * @segment      index of the segment to resume
+ * @vaddr        address to resume at in it
+ *
+ * Headers and notes must have been written up to @data_offset. If the
+ * journal matches them, *@segment and *@vaddr are set to where the
+ * last run stopped and the core file is truncated there; otherwise,
+ * they are set to the start of the first segment. The journal is
+ * created here if there is none yet.
+ */
+void gcore_journal_begin_data(struct gcore_writer *writer, off_t data_offset,
+			      ulong *segment, ulong *vaddr)
+{
+	struct gcore_journal_record *r = &gjd->rec;
+	int fd = gcore_writer_fd(writer);
+	uint64_t layout;
+
+	*segment = 0;
+	*vaddr = gcore->nr_segments ? gcore->segments[0].vaddr : 0;
+
+	if (!gjd->enabled)
+		return;
+
+	if (fd < 0) {
+		error(WARNING, "%s: not a regular file; not resumable\n",
+		      gcore->corename);
+		gcore_journal_close(FALSE);
+		return;
+	}
+
+	if (gjd->fd < 0 &&
+	    (gjd->fd = open(gjd->name, O_RDWR|O_CREAT|O_TRUNC, 0666)) < 0) {
+		error(WARNING, "%s: open: %s; not resumable\n", gjd->name,
+		      strerror(errno));
+		gcore_journal_close(FALSE);
+		return;
+	}
+
+	if (!gcore_writer_flush(writer) ||
+	    !journal_hash_file(fd, data_offset, &layout))
+		error(FATAL, "%s: %s\n", gcore->corename, strerror(errno));
+
+	if (gjd->resuming) {
+		gjd->resuming = FALSE;
+		if (r->layout != layout || r->data_offset != data_offset ||
+		    r->segment >= gcore->nr_segments ||
+		    r->vaddr < gcore->segments[r->segment].vaddr ||
+		    r->vaddr > gcore->segments[r->segment].vaddr +
+		    gcore->segments[r->segment].filesz)
+			error(INFO, "%s: layout differs from %s; copying "
+			      "from the start\n", gcore->corename, gjd->name);
+		else {
+			*segment = r->segment;
+			*vaddr = r->vaddr;
+			error(INFO, "%s: resuming at PT_LOAD[%lu] %lx, %llu "
+			      "bytes already copied\n", gcore->corename,
+			      *segment, *vaddr,
+			      (ulonglong)(r->offset - data_offset));
+		}
+	}
+
+	r->magic = GCORE_JOURNAL_MAGIC;
+	r->version = GCORE_JOURNAL_VERSION;
+	r->layout = layout;
+	r->data_offset = data_offset;
+	r->segment = *segment;
+	r->vaddr = *vaddr;
+	r->offset = data_offset;
+	if (*segment < gcore->nr_segments)
+		r->offset = gcore->segments[*segment].offset +
+			(*vaddr - gcore->segments[*segment].vaddr);
+
+	/* Drop whatever the last run wrote past that point. */
+	if (ftruncate(fd, r->offset) < 0 || !journal_write())
+		error(FATAL, "%s: %s\n", gcore->corename, strerror(errno));
+}
+
+/**
+ * Return TRUE if progress is being recorded.
+ */
+int gcore_journal_active(void)
+{
+	return gjd->fd >= 0;
+}
+
+/**
+ * Record that all data of the core before @vaddr of PT_LOAD[@segment]
+ * has been copied, once it is on disk, if GCORE_JOURNAL_INTERVAL bytes
+ * or more have been copied since the last record.
+ */
+void gcore_journal_checkpoint(ulong segment, ulong vaddr)
+{
+	struct gcore_journal_record *r = &gjd->rec;
+	loff_t offset;
+
+	if (gjd->fd < 0)
+		return;
+
+	offset = gcore->segments[segment].offset +
+		(vaddr - gcore->segments[segment].vaddr);
+	if (offset - r->offset < GCORE_JOURNAL_INTERVAL)
+		return;
+
+	gcore_copy_sync();
+	if (fdatasync(gcore_writer_fd(gcore->writer)) < 0)
+		error(FATAL, "%s: fdatasync: %s\n", gcore->corename,
+		      strerror(errno));
+
+	r->segment = segment;
+	r->vaddr = vaddr;
+	r->offset = offset;
+
+	if (!journal_write())
+		error(FATAL, "%s: write: %s\n", gjd->name, strerror(errno));
+}
+
+/**
+ * Close the journal, and remove it if the core has been @saved.
+ */
+void gcore_journal_close(int saved)
+{
+	if (gjd->fd >= 0) {
+		close(gjd->fd);
+		if (saved && unlink(gjd->name) < 0)
+			error(WARNING, "%s: unlink: %s\n", gjd->name,
+			      strerror(errno));
+	}
+
+	gjd->fd = -1;
+	gjd->enabled = FALSE;
+	gjd->resuming = FALSE;
+}
+
+/*
+ * 64-bit FNV-1a, continuing from @hash, or starting if it is 0.
+ */
+static uint64_t journal_hash(const void *buf, size_t len, uint64_t hash)
+{
+	const unsigned char *p = buf;
+	size_t i;
+
+	if (!hash)
+		hash = 0xcbf29ce484222325ULL;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static int journal_hash_file(int fd, off_t len, uint64_t *hash)
+{
+	char *buf = GETBUF(PAGE_SIZE);
+	off_t off;
+
+	*hash = 0;
+
+	for (off = 0; off < len;) {
+		ssize_t n = pread(fd, buf, MIN(PAGE_SIZE, len - off), off);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (!n)
+				errno = EIO;
+			FREEBUF(buf);
+			return FALSE;
+		}
+		*hash = journal_hash(buf, n, *hash);
+		off += n;
+	}
+
+	FREEBUF(buf);
+	return TRUE;
+}
+
+static int journal_write(void)
+{
+	struct gcore_journal_record *r = &gjd->rec;
+
+	r->checksum = journal_hash(r, offsetof(struct gcore_journal_record,
+					       checksum), 0);
+
+	return pwrite(gjd->fd, r, sizeof(*r), 0) == sizeof(*r) &&
+		fdatasync(gjd->fd) == 0;
+}
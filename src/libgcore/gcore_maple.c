@@ -0,0 +1,218 @@
+/* gcore_maple.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+
+/*
+ * VMA iteration over the maple tree.
+ *
+ * Since Linux 6.1, mm_struct has no mmap list and vm_area_struct no
+ * vm_next; VMAs are kept in the maple tree mm->mm_mt, indexed by
+ * address. first_vma() walks the whole tree once, reading each node
+ * in one go, and collects the VMAs found in the leaves in address
+ * order; next_vma() then steps through them.
+ *
+ * Node layout follows lib/maple_tree.c: an encoded node pointer has
+ * its type in bits 3-6 and the node at its 256-byte aligned address.
+ * Range nodes hold pivots, the inclusive upper bound of each slot, and
+ * a slot whose pivot is 0 past the first, or that reaches the upper
+ * bound of the node, ends the node.
+ */
+
+#define MAPLE_NODE_MASK		255UL
+#define MAPLE_NODE_TYPE_SHIFT	3
+#define MAPLE_NODE_TYPE_MASK	0x0f
+#define MAPLE_MAX_DEPTH		16
+
+enum maple_type {
+	maple_dense,
+	maple_leaf_64,
+	maple_range_64,
+	maple_arange_64,
+};
+
+struct gcore_maple_data
+{
+	ulong *vmas;		/* VMAs of the last tree walked */
+	ulong nr_vmas;
+	ulong max_vmas;
+	ulong pos;		/* of the VMA last returned */
+	ulong nodes;
+};
+
+static struct gcore_maple_data gcore_maple_data;
+static struct gcore_maple_data *gmd = &gcore_maple_data;
+
+static void maple_walk(ulong entry, ulong min, ulong max, int depth);
+static void maple_add_vma(ulong vma);
+
+static inline int maple_is_node(ulong entry)
+{
+	return (entry & 3) == 2 && entry > 4096;
+}
+
+/**
+ * Return TRUE if VMAs of this kernel are kept in a maple tree.
+ */
+int gcore_maple_vma_tree(void)
+{
+	return GCORE_VALID_MEMBER(mm_struct_mm_mt);
+}
+
+/**
+ * gcore_maple_first_vma - walk the maple tree of VMAs at @mt
+ *
+ * @mt  address of mm_struct.mm_mt
+ *
+ * Return Value:
+ *
+ *   The VMA at the lowest address, or 0 if the tree is empty.
+ */
+ulong gcore_maple_first_vma(ulong mt)
+{
+	ulong root;
+
+	gmd->max_vmas = 256;
+	gmd->vmas = (ulong *)GETBUF(gmd->max_vmas * sizeof(ulong));
+	gmd->nr_vmas = gmd->pos = gmd->nodes = 0;
+
+	if (!readmem(mt + GCORE_OFFSET(maple_tree_ma_root), KVADDR, &root,
+		     sizeof(root), "gcore_maple_first_vma: ma_root",
+		     gcore_verbose_error_handle()))
+		return 0UL;
+
+	if (maple_is_node(root))
+		maple_walk(root, 0, ~0UL, 0);
+	else if (root && !(root & 3))
+		maple_add_vma(root);	/* a single entry at index 0 */
+
+	progressf("Read %lu maple tree nodes for %lu VMAs\n", gmd->nodes,
+		  gmd->nr_vmas);
+
+	return gmd->nr_vmas ? gmd->vmas[0] : 0UL;
+}
+
+/**
+ * Return the VMA following @vma in the tree last walked by
+ * gcore_maple_first_vma(), or 0 after the last one.
+ */
+ulong gcore_maple_next_vma(ulong vma)
+{
+	ulong i;
+
+	/* Callers step through the VMAs in order. */
+	if (gmd->pos < gmd->nr_vmas && gmd->vmas[gmd->pos] == vma)
+		i = gmd->pos;
+	else
+		for (i = 0; i < gmd->nr_vmas && gmd->vmas[i] != vma; i++)
+			;
+
+	if (i + 1 >= gmd->nr_vmas)
+		return 0UL;
+
+	gmd->pos = i + 1;
+	return gmd->vmas[gmd->pos];
+}
+
+/*
+ * Collect the VMAs under the encoded node @entry, which covers the
+ * indices [@min, @max], in index order.
+ */
+static void maple_walk(ulong entry, ulong min, ulong max, int depth)
+{
+	enum maple_type type;
+	long pivot_off, slot_off;
+	int i, nr_pivots;
+	ulong first, last;
+	char *node;
+
+	if (depth > MAPLE_MAX_DEPTH) {
+		error(WARNING, "maple tree: too deep at %lx\n", entry);
+		return;
+	}
+
+	type = (entry >> MAPLE_NODE_TYPE_SHIFT) & MAPLE_NODE_TYPE_MASK;
+
+	switch (type) {
+	case maple_leaf_64:
+	case maple_range_64:
+		pivot_off = GCORE_OFFSET(maple_range_64_pivot);
+		nr_pivots = GCORE_SIZE(maple_range_64_pivot) / sizeof(ulong);
+		break;
+	case maple_arange_64:
+		pivot_off = GCORE_OFFSET(maple_arange_64_pivot);
+		nr_pivots = GCORE_SIZE(maple_arange_64_pivot) / sizeof(ulong);
+		break;
+	default:
+		error(WARNING, "maple tree: unexpected node type %d at %lx\n",
+		      type, entry);
+		return;
+	}
+
+	/* The slots follow the pivots, one more of them. */
+	slot_off = pivot_off + nr_pivots * sizeof(ulong);
+
+	node = GETBUF(GCORE_SIZE(maple_node));
+
+	if (!gcore_readmem(entry & ~MAPLE_NODE_MASK, KVADDR, node,
+			   GCORE_SIZE(maple_node), "maple_walk: node",
+			   gcore_verbose_error_handle())) {
+		FREEBUF(node);
+		return;
+	}
+
+	gmd->nodes++;
+
+	first = min;
+
+	for (i = 0; i <= nr_pivots; i++) {
+		ulong slot = ULONG(node + slot_off + i * sizeof(ulong));
+
+		last = i < nr_pivots ?
+			ULONG(node + pivot_off + i * sizeof(ulong)) : max;
+		if (i > 0 && last == 0)
+			break;
+
+		if (slot) {
+			if (type == maple_leaf_64) {
+				if (!(slot & 3))
+					maple_add_vma(slot);
+			} else if (maple_is_node(slot))
+				maple_walk(slot, first, last, depth + 1);
+		}
+
+		if (last >= max)
+			break;
+		first = last + 1;
+	}
+
+	FREEBUF(node);
+}
+
+static void maple_add_vma(ulong vma)
+{
+	if (gmd->nr_vmas == gmd->max_vmas) {
+		ulong *vmas;
+
+		vmas = (ulong *)GETBUF(2 * gmd->max_vmas * sizeof(ulong));
+		memcpy(vmas, gmd->vmas, gmd->nr_vmas * sizeof(ulong));
+		FREEBUF(gmd->vmas);
+		gmd->vmas = vmas;
+		gmd->max_vmas *= 2;
+	}
+
+	gmd->vmas[gmd->nr_vmas++] = vma;
+}
@@ -60,8 +60,8 @@ static int gpr_get(struct task_context *target,
 		error(WARNING, "WARNING: Current register values may be inaccurate\n");
 	}
 
-	readmem(machdep->get_stacktop(target->task) - 32 - SIZE(pt_regs),
-		KVADDR, pt_regs, SIZE(pt_regs), "genregs_get: pt_regs",
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, pt_regs, SIZE(pt_regs), "genregs_get: pt_regs",
 		gcore_verbose_error_handle());
 
 	mains = (struct mips_pt_regs_main *) (pt_regs + OFFSET(pt_regs_regs));
@@ -156,4 +156,9 @@ int gcore_arch_vsyscall_has_vm_alwaysdump_flag(void)
 	return FALSE;
 }
 
+ulong gcore_arch_user_regs(struct task_context *tc)
+{
+	return machdep->get_stacktop(tc->task) - 32 - SIZE(pt_regs);
+}
+
 #endif /* defined(MIPS) */
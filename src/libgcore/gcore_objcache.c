@@ -0,0 +1,322 @@
+/* gcore_objcache.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+
+/*
+ * Kernel object cache.
+ *
+ * Note information is gathered with many small readmem() calls of a
+ * few bytes each into task_struct, signal_struct, cred and the pid
+ * structures, and the same fields are read again and again, per
+ * thread and per helper. Instead, the first read of a field of such
+ * an object reads the whole object once, and the following ones are
+ * served from that snapshot. The user registers saved at the top of
+ * the kernel stack and an FPU state kept outside task_struct are
+ * cached the same way, so that they can be read ahead with the rest.
+ *
+ * Snapshots are allocated with GETBUF() and so live for one session;
+ * a dump file does not change, so they never become stale within it.
+ * A field outside the object, for instance in the flexible array at
+ * the end of struct pid, or an object that cannot be read as a whole,
+ * is read with readmem() as before, and so is any read made outside
+ * gcore_coredump(), before the cache of the session is set up.
+ */
+
+struct gcore_objcache_entry
+{
+	ulong obj;		/* 0 for an empty slot */
+	int type;
+	char *data;		/* NULL if the object cannot be read whole */
+};
+
+struct gcore_objcache_data
+{
+	struct gcore_objcache_entry *table;
+	ulong size;		/* power of 2 */
+	ulong used;
+	ulong bytes;		/* held in snapshots */
+	struct gcore_objcache_stats stats;
+};
+
+static struct gcore_objcache_data gcore_objcache_data;
+static struct gcore_objcache_data *goc = &gcore_objcache_data;
+
+static const char *objcache_names[GCORE_OBJ_NR_TYPES] = {
+	[GCORE_OBJ_TASK] = "task_struct",
+	[GCORE_OBJ_SIGNAL] = "signal_struct",
+	[GCORE_OBJ_CRED] = "cred",
+	[GCORE_OBJ_NSPROXY] = "nsproxy",
+	[GCORE_OBJ_PID] = "pid",
+	[GCORE_OBJ_PID_NS] = "pid_namespace",
+	[GCORE_OBJ_PT_REGS] = "pt_regs",
+};
+
+static long objcache_sizes[GCORE_OBJ_NR_TYPES];
+
+static struct gcore_objcache_entry *objcache_slot(int type, ulong obj);
+static void objcache_grow(void);
+static int objcache_kvtop(ulong obj, long size, physaddr_t *paddr);
+static int objcache_compare(const void *a, const void *b);
+
+/**
+ * Look up the sizes of the cached structures once.
+ */
+void gcore_objcache_table_init(void)
+{
+	int i;
+
+	for (i = 0; i < GCORE_OBJ_NR_TYPES; i++)
+		if (objcache_names[i])
+			objcache_sizes[i] = STRUCT_SIZE(objcache_names[i]);
+}
+
+/**
+ * Set the size of a cached area that is not described by a structure
+ * of its own, such as the FPU state. Types left at 0 are not cached.
+ */
+void gcore_objcache_set_size(int type, long size)
+{
+	objcache_sizes[type] = size;
+}
+
+/**
+ * Start a session with an empty cache and zero statistics.
+ */
+void gcore_objcache_init(void)
+{
+	BZERO(goc, sizeof(*goc));
+}
+
+/**
+ * gcore_objcache_readmem - read a field of a kernel object
+ *
+ * @type         GCORE_OBJ_* type of the object
+ * @obj          kernel virtual address of the object
+ * @offset       offset of the field in the object
+ * @buffer       where to copy the field
+ * @size         size of the field
+ * @type_string  and
+ * @error_handle as for readmem()
+ *
+ * Return Value:
+ *
+ *   As readmem() called for @obj + @offset.
+ */
+int gcore_objcache_readmem(int type, ulong obj, long offset, void *buffer,
+			   long size, char *type_string, ulong error_handle)
+{
+	struct gcore_objcache_entry *e = NULL;
+	long objsize = objcache_sizes[type];
+
+	goc->stats.fields++;
+
+	if (!(gcore->flags & GCF_UNDER_COREDUMP) || !obj || objsize <= 0 ||
+	    offset < 0 || offset + size > objsize)
+		goto uncached;
+
+	if (goc->size)
+		e = objcache_slot(type, obj);
+
+	if (!e || !e->obj) {
+		if (goc->bytes + objsize > GCORE_OBJCACHE_MAX_BYTES)
+			goto uncached;
+		if (2 * (goc->used + 1) > goc->size) {
+			objcache_grow();
+			e = objcache_slot(type, obj);
+		}
+		e->obj = obj;
+		e->type = type;
+		e->data = GETBUF(objsize);
+		goc->used++;
+		goc->stats.objects++;
+		if (gcore_readmem(obj, KVADDR, e->data, objsize,
+				  type_string, RETURN_ON_ERROR|QUIET))
+			goc->bytes += objsize;
+		else {
+			FREEBUF(e->data);
+			e->data = NULL;
+		}
+	}
+
+	if (!e->data)
+		goto uncached;
+
+	memcpy(buffer, e->data + offset, size);
+	return TRUE;
+
+uncached:
+	goc->stats.uncached++;
+	return gcore_readmem(obj + offset, KVADDR, buffer, size, type_string,
+			     error_handle);
+}
+
+/**
+ * gcore_objcache_prefetch - read kernel objects ahead, in parallel
+ *
+ * @type  GCORE_OBJ_* type of the objects
+ * @objs  kernel virtual addresses of the objects
+ * @nr    number of objects
+ *
+ * With -j threads and an ELF dump file, the objects that are not cached
+ * yet and are physically contiguous are read from the dump file by
+ * worker threads, which never call into crash. Objects left out, or
+ * that fail to be read, are read by gcore_objcache_readmem() as usual.
+ */
+void gcore_objcache_prefetch(int type, ulong *objs, int nr)
+{
+	struct gcore_parallel_read *reads;
+	struct gcore_objcache_entry *e;
+	long objsize = objcache_sizes[type];
+	ulong *addrs, bytes = goc->bytes;
+	int i, n = 0;
+
+	if (!(gcore->flags & GCF_UNDER_COREDUMP) || objsize <= 0 ||
+	    gcore_parallel_get() < 2 || nr < 2)
+		return;
+
+	reads = (struct gcore_parallel_read *)GETBUF(nr * sizeof(*reads));
+	addrs = (ulong *)GETBUF(nr * sizeof(ulong));
+
+	/* Threads often share objects, such as their cred. */
+	BCOPY(objs, addrs, nr * sizeof(ulong));
+	qsort(addrs, nr, sizeof(ulong), objcache_compare);
+
+	for (i = 0; i < nr; i++) {
+		if (!addrs[i] || (i && addrs[i] == addrs[i - 1]) ||
+		    bytes + objsize > GCORE_OBJCACHE_MAX_BYTES)
+			continue;
+		if (goc->size && objcache_slot(type, addrs[i])->obj)
+			continue;
+		if (!objcache_kvtop(addrs[i], objsize, &reads[n].paddr))
+			continue;
+		reads[n].len = objsize;
+		reads[n].buf = GETBUF(objsize);
+		addrs[n++] = addrs[i];
+		bytes += objsize;
+	}
+
+	if (n && !gcore_parallel_read(reads, n))
+		for (i = 0; i < n; i++)
+			reads[i].done = FALSE;
+
+	for (i = 0; i < n; i++) {
+		if (!reads[i].done) {
+			FREEBUF(reads[i].buf);
+			continue;
+		}
+		if (2 * (goc->used + 1) > goc->size)
+			objcache_grow();
+		e = objcache_slot(type, addrs[i]);
+		if (e->obj) {
+			FREEBUF(reads[i].buf);
+			continue;
+		}
+		e->obj = addrs[i];
+		e->type = type;
+		e->data = reads[i].buf;
+		goc->used++;
+		goc->bytes += objsize;
+		goc->stats.objects++;
+		goc->stats.prefetched++;
+	}
+
+	FREEBUF(addrs);
+	FREEBUF(reads);
+}
+
+/**
+ * Return the statistics collected since gcore_objcache_init().
+ */
+const struct gcore_objcache_stats *gcore_objcache_get_stats(void)
+{
+	return &goc->stats;
+}
+
+/**
+ * Print how many readmem() calls the cache saved in this session.
+ */
+void gcore_objcache_report(void)
+{
+	const struct gcore_objcache_stats *s = &goc->stats;
+	ulong calls = s->objects + s->uncached;
+
+	progressf("Read %lu kernel objects (%lu ahead in parallel) for %lu "
+		  "field reads; %lu readmem() calls saved\n", s->objects,
+		  s->prefetched, s->fields,
+		  s->fields > calls ? s->fields - calls : 0);
+}
+
+static struct gcore_objcache_entry *objcache_slot(int type, ulong obj)
+{
+	ulong i = ((obj >> 4) * 0x9E3779B97F4A7C15ULL + type)
+		& (goc->size - 1);
+
+	while (goc->table[i].obj &&
+	       (goc->table[i].obj != obj || goc->table[i].type != type))
+		i = (i + 1) & (goc->size - 1);
+
+	return &goc->table[i];
+}
+
+static int objcache_compare(const void *a, const void *b)
+{
+	ulong x = *(const ulong *)a, y = *(const ulong *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Translate @obj, and check that its @size bytes are physically
+ * contiguous, so that it can be read in one go from the dump file.
+ */
+static int objcache_kvtop(ulong obj, long size, physaddr_t *paddr)
+{
+	physaddr_t p;
+	ulong addr;
+
+	if (!kvtop(CURRENT_CONTEXT(), obj, paddr, FALSE))
+		return FALSE;
+
+	for (addr = PAGEBASE(obj) + PAGESIZE(); addr < obj + size;
+	     addr += PAGESIZE())
+		if (!kvtop(CURRENT_CONTEXT(), addr, &p, FALSE) ||
+		    p != *paddr + (addr - obj))
+			return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * Double the hash table, keeping it at most half full.
+ */
+static void objcache_grow(void)
+{
+	struct gcore_objcache_entry *old = goc->table;
+	ulong i, oldsize = goc->size;
+
+	goc->size = oldsize ? 2 * oldsize : 1024;
+	goc->table = (struct gcore_objcache_entry *)
+		GETBUF(goc->size * sizeof(*goc->table));
+	BZERO(goc->table, goc->size * sizeof(*goc->table));
+
+	if (old) {
+		for (i = 0; i < oldsize; i++)
+			if (old[i].obj)
+				*objcache_slot(old[i].type, old[i].obj) = old[i];
+		FREEBUF(old);
+	}
+}
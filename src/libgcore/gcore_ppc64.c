@@ -28,8 +28,8 @@ static int gpr_get(struct task_context *target,
 
 	BZERO(regs, sizeof(*regs));
 
-	readmem(machdep->get_stacktop(target->task) - SIZE(pt_regs), KVADDR,
-		regs, SIZE(pt_regs), "genregs_get: pt_regs",
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, regs, SIZE(pt_regs), "genregs_get: pt_regs",
 		gcore_verbose_error_handle());
 
 	return 0;
@@ -26,8 +26,9 @@ static int genregs_get(struct task_context *target,
 		       unsigned int size,
 		       void *buf)
 {
-	readmem(machdep->get_stacktop(target->task) - SIZE(pt_regs), KVADDR,
-		buf, size, "genregs_get: pt_regs", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, buf, size, "genregs_get: pt_regs",
+		gcore_verbose_error_handle());
 
 	return 0;
 }
@@ -64,3 +65,23 @@ gcore_arch_get_fp_valid(struct task_context *tc)
 {
 	return 0;
 }
+
+/**
+ * Return the address of the user registers saved by the kernel entry
+ * code for @tc, at the top of its kernel stack.
+ */
+ulong __attribute__((weak))
+gcore_arch_user_regs(struct task_context *tc)
+{
+	return machdep->get_stacktop(tc->task) - SIZE(pt_regs);
+}
+
+/**
+ * Return the address of the FPU state of @tc when it is kept outside
+ * task_struct, or 0 when it is embedded in it or there is none.
+ */
+ulong __attribute__((weak))
+gcore_arch_fpu_area(struct task_context *tc)
+{
+	return 0;
+}
@@ -0,0 +1,261 @@
+/* gcore_uring.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+
+/*
+ * A minimal io_uring used by the writer to keep several buffer
+ * flushes in flight, so that reading the next pages from the dump
+ * overlaps with writing the previous ones. Only writes are submitted,
+ * and the ring is driven by raw system calls so as not to depend on
+ * liburing.
+ */
+
+#ifdef GCORE_HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct gcore_uring
+{
+	int fd;
+	unsigned entries;
+	unsigned inflight;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+/**
+ * Set up a ring with room for @entries writes in flight.
+ *
+ * Return Value:
+ *
+ *   The ring, or NULL with errno set if io_uring is not available.
+ */
+struct gcore_uring *gcore_uring_init(unsigned entries)
+{
+	struct io_uring_params p;
+	struct gcore_uring *r;
+	char *sq, *cq;
+
+	if (!(r = calloc(1, sizeof(*r))))
+		return NULL;
+
+	BZERO(&p, sizeof(p));
+	r->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0) {
+		free(r);
+		return NULL;
+	}
+	r->entries = p.sq_entries;
+
+	r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_ring_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->sq_ring_size = r->cq_ring_size =
+			MAX(r->sq_ring_size, r->cq_ring_size);
+
+	r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ|PROT_WRITE,
+			  MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED)
+		goto fail_close;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->cq_ring = r->sq_ring;
+	else {
+		r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ|PROT_WRITE,
+				  MAP_SHARED|MAP_POPULATE, r->fd,
+				  IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED)
+			goto fail_sq;
+	}
+
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		goto fail_cq;
+
+	sq = r->sq_ring;
+	r->sq_head = (unsigned *)(sq + p.sq_off.head);
+	r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+	cq = r->cq_ring;
+	r->cq_head = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	return r;
+
+fail_cq:
+	if (r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring, r->cq_ring_size);
+fail_sq:
+	munmap(r->sq_ring, r->sq_ring_size);
+fail_close:
+	close(r->fd);
+	free(r);
+	return NULL;
+}
+
+/**
+ * Return how many more writes can be submitted.
+ */
+unsigned gcore_uring_space(struct gcore_uring *r)
+{
+	return r->entries - r->inflight;
+}
+
+/**
+ * Submit a write of @len bytes of @buf at @offset of @fd. @data is
+ * given back by gcore_uring_wait() when the write completes.
+ *
+ * Precondition:
+ *
+ *   gcore_uring_space(@r) > 0.
+ *
+ * Return Value:
+ *
+ *   TRUE on success; FALSE with errno set otherwise.
+ */
+int gcore_uring_write(struct gcore_uring *r, int fd, const void *buf,
+		      size_t len, off_t offset, ulong data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail, index;
+	int ret;
+
+	tail = *r->sq_tail;
+	index = tail & *r->sq_mask;
+
+	sqe = &r->sqes[index];
+	BZERO(sqe, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = fd;
+	sqe->addr = (ulong)buf;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = data;
+
+	r->sq_array[index] = index;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	do {
+		ret = syscall(__NR_io_uring_enter, r->fd, 1, 0, 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		return FALSE;
+
+	r->inflight++;
+
+	return TRUE;
+}
+
+/**
+ * Wait for one submitted write to complete.
+ *
+ * Return Value:
+ *
+ *   TRUE with *@data and *@res, the number of bytes written or a
+ *   negative errno value, of the completed write. FALSE with errno
+ *   set if waiting itself failed or nothing is in flight.
+ */
+int gcore_uring_wait(struct gcore_uring *r, ulong *data, int *res)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head;
+
+	if (!r->inflight) {
+		errno = EINVAL;
+		return FALSE;
+	}
+
+	for (;;) {
+		head = *r->cq_head;
+		if (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+			break;
+		if (syscall(__NR_io_uring_enter, r->fd, 0, 1,
+			    IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+		    errno != EINTR)
+			return FALSE;
+	}
+
+	cqe = &r->cqes[head & *r->cq_mask];
+	*data = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	r->inflight--;
+
+	return TRUE;
+}
+
+void gcore_uring_exit(struct gcore_uring *r)
+{
+	munmap(r->sqes, r->sqes_size);
+	if (r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring, r->cq_ring_size);
+	munmap(r->sq_ring, r->sq_ring_size);
+	close(r->fd);
+	free(r);
+}
+
+#else /* GCORE_HAVE_IO_URING */
+
+struct gcore_uring *gcore_uring_init(unsigned entries)
+{
+	errno = ENOSYS;
+	return NULL;
+}
+
+unsigned gcore_uring_space(struct gcore_uring *r)
+{
+	return 0;
+}
+
+int gcore_uring_write(struct gcore_uring *r, int fd, const void *buf,
+		      size_t len, off_t offset, ulong data)
+{
+	errno = ENOSYS;
+	return FALSE;
+}
+
+int gcore_uring_wait(struct gcore_uring *r, ulong *data, int *res)
+{
+	errno = ENOSYS;
+	return FALSE;
+}
+
+void gcore_uring_exit(struct gcore_uring *r)
+{
+}
+
+#endif /* GCORE_HAVE_IO_URING */
@@ -15,11 +15,14 @@
 
 #include "defs.h"
 #include <gcore_defs.h>
+#include <time.h>
 
 struct gcore_verbose_data
 {
 	ulong level;
 	ulong error_handle;
+	int faults;		/* GCORE_FAULTS_* */
+	ulong fault_lines;	/* per core, in GCORE_FAULTS_RANGES mode */
 };
 
 static struct gcore_verbose_data gcore_verbose_data = { 0 };
@@ -45,6 +48,8 @@ void gcore_verbose_set_default(void)
 {
 	gvd->level = VERBOSE_DEFAULT_LEVEL;
 	gvd->error_handle = VERBOSE_DEFAULT_ERROR_HANDLE;
+	gvd->faults = GCORE_FAULTS_RANGES;
+	gvd->fault_lines = GCORE_FAULTS_DEFAULT_LINES;
 }
 
 /**
@@ -90,3 +95,271 @@ ulong gcore_verbose_error_handle(void)
 {
 	return gvd->error_handle;
 }
+
+/**
+ * set how page faults are reported from a --faults argument
+ *
+ * @mode  "ranges[:N]", "summary" or "pages"
+ *
+ * Return Value:
+ *
+ *   TRUE if @mode is valid; FALSE otherwise, leaving the mode as is.
+ */
+int gcore_verbose_set_faults(char *mode)
+{
+	char *end;
+
+	if (STREQ(mode, "summary"))
+		gvd->faults = GCORE_FAULTS_SUMMARY;
+	else if (STREQ(mode, "pages"))
+		gvd->faults = GCORE_FAULTS_PAGES;
+	else if (STREQ(mode, "ranges"))
+		gvd->faults = GCORE_FAULTS_RANGES;
+	else if (STRNEQ(mode, "ranges:")) {
+		ulong lines = strtoul(mode + 7, &end, 10);
+
+		if (end == mode + 7 || *end)
+			return FALSE;
+		gvd->faults = GCORE_FAULTS_RANGES;
+		gvd->fault_lines = lines;
+	} else
+		return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * Page faults met while copying the core being written. In ranges
+ * mode, faulted pages contiguous in the same segment are printed as
+ * one range, up to fault_lines lines per core; the summary counts
+ * them all.
+ */
+struct gcore_pagefault_data
+{
+	ulong start, end;	/* pending range; empty if equal */
+	ulong pages;
+	ulong ranges;
+	ulong lines;
+};
+
+static struct gcore_pagefault_data gcore_pagefault_data;
+static struct gcore_pagefault_data *gpf = &gcore_pagefault_data;
+
+/**
+ * Start reporting the page faults of a new core.
+ */
+void gcore_pagefault_init(void)
+{
+	BZERO(gpf, sizeof(*gpf));
+}
+
+/**
+ * Record that the @nr_pages pages from @addr on are page-faulted.
+ */
+void gcore_pagefault(ulong addr, ulong nr_pages)
+{
+	ulong i;
+
+	gpf->pages += nr_pages;
+
+	if (gvd->faults == GCORE_FAULTS_PAGES) {
+		for (i = 0; i < nr_pages; i++)
+			pagefaultf("page fault at %lx\n", addr + i * PAGE_SIZE);
+		return;
+	}
+
+	if (gpf->end != addr)
+		gcore_pagefault_flush();
+	if (gpf->start == gpf->end) {
+		gpf->start = addr;
+		gpf->ranges++;
+	}
+	gpf->end = addr + nr_pages * PAGE_SIZE;
+}
+
+/**
+ * Print the pending range of page faults, at the end of a segment or
+ * when a non-contiguous one begins.
+ */
+void gcore_pagefault_flush(void)
+{
+	if (gpf->start == gpf->end)
+		return;
+
+	if (gvd->faults == GCORE_FAULTS_RANGES &&
+	    gpf->lines < gvd->fault_lines) {
+		pagefaultf("page faults at [%lx, %lx) %lu pages\n", gpf->start,
+			   gpf->end, (gpf->end - gpf->start) / PAGE_SIZE);
+		gpf->lines++;
+	}
+
+	gpf->start = gpf->end = 0;
+}
+
+/**
+ * Print how many pages of the core just copied are page-faulted, and
+ * in how many ranges.
+ */
+void gcore_pagefault_report(void)
+{
+	gcore_pagefault_flush();
+
+	if (!gpf->pages || gvd->faults == GCORE_FAULTS_PAGES)
+		return;
+
+	if (gpf->ranges > gpf->lines && gvd->faults == GCORE_FAULTS_RANGES)
+		pagefaultf("%lu pages page-faulted in %lu ranges (%lu ranges "
+			   "not shown)\n", gpf->pages, gpf->ranges,
+			   gpf->ranges - gpf->lines);
+	else
+		pagefaultf("%lu pages page-faulted in %lu ranges\n",
+			   gpf->pages, gpf->ranges);
+}
+
+/*
+ * Phase timing and counters of the core being written.
+ */
+struct gcore_phase_time
+{
+	struct timespec wall_start, cpu_start;
+	double wall, cpu;	/* seconds, summed over all calls */
+	int depth;		/* nested calls of the same phase */
+};
+
+struct gcore_stats_data
+{
+	struct gcore_phase_time phases[GCORE_PHASE_NR];
+};
+
+static struct gcore_stats_data gcore_stats_data;
+static struct gcore_stats_data *gsd = &gcore_stats_data;
+
+ulong gcore_counters[GCORE_COUNT_NR];
+
+static const char *phase_names[GCORE_PHASE_NR] = {
+	[GCORE_PHASE_VMAS] = "vmas",
+	[GCORE_PHASE_OPEN] = "open",
+	[GCORE_PHASE_ELF_HEADER] = "elf_header",
+	[GCORE_PHASE_NOTES] = "notes",
+	[GCORE_PHASE_REGSETS] = "regsets",
+	[GCORE_PHASE_PHDRS] = "phdrs",
+	[GCORE_PHASE_COPY] = "copy",
+};
+
+static double timespec_diff(const struct timespec *start,
+			    const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void print_json_string(const char *str)
+{
+	const unsigned char *p;
+
+	fputc('"', fp);
+	for (p = (const unsigned char *)str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+/**
+ * Start timing and counting a new core.
+ */
+void gcore_stats_init(void)
+{
+	BZERO(gsd, sizeof(*gsd));
+	BZERO(gcore_counters, sizeof(gcore_counters));
+}
+
+/**
+ * Start timing @phase. Calls may nest, as long as each is paired with
+ * gcore_phase_end(); only the outermost one is timed.
+ */
+void gcore_phase_begin(int phase)
+{
+	struct gcore_phase_time *p = &gsd->phases[phase];
+
+	if (p->depth++)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &p->wall_start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &p->cpu_start);
+}
+
+/**
+ * Stop timing @phase, adding the time since gcore_phase_begin().
+ */
+void gcore_phase_end(int phase)
+{
+	struct gcore_phase_time *p = &gsd->phases[phase];
+	struct timespec wall, cpu;
+
+	if (p->depth <= 0 || --p->depth)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+	p->wall += timespec_diff(&p->wall_start, &wall);
+	p->cpu += timespec_diff(&p->cpu_start, &cpu);
+}
+
+/**
+ * Print the phase times and counters of the core just written: as a
+ * table with VERBOSE_STATS, as one JSON line with VERBOSE_STATS_JSON.
+ * CPU time is that of the whole process, copy threads included.
+ */
+void gcore_stats_report(void)
+{
+	const struct gcore_copy_stats *cs = gcore_copy_get_stats();
+	ulonglong bytes = gcore_writer_bytes(gcore->writer);
+	ulong zero = cs->zero + cs->zero_pfn;
+	int i;
+
+	if (gcore_verbose_get() & VERBOSE_STATS) {
+		fprintf(fp, "%s:\n", gcore->corename);
+		fprintf(fp, "  %-12s %12s %12s\n", "PHASE", "WALL (s)",
+			"CPU (s)");
+		for (i = 0; i < GCORE_PHASE_NR; i++)
+			fprintf(fp, "  %-12s %12.6f %12.6f\n", phase_names[i],
+				gsd->phases[i].wall, gsd->phases[i].cpu);
+		fprintf(fp, "  %-20s %lu\n", "pages read", cs->present);
+		fprintf(fp, "  %-20s %lu\n", "pages faulted", cs->faulted);
+		fprintf(fp, "  %-20s %lu\n", "zero pages", zero);
+		fprintf(fp, "  %-20s %lu\n", "pages excluded",
+			cs->excluded);
+		fprintf(fp, "  %-20s %llu\n", "bytes written", bytes);
+		fprintf(fp, "  %-20s %lu\n", "translations",
+			cs->translations);
+		fprintf(fp, "  %-20s %lu\n", "readmem calls",
+			gcore_counters[GCORE_COUNT_READMEM]);
+		fprintf(fp, "  %-20s %lu\n", "uvtop calls",
+			gcore_counters[GCORE_COUNT_UVTOP]);
+	}
+
+	if (gcore_verbose_get() & VERBOSE_STATS_JSON) {
+		fprintf(fp, "{\"core\": ");
+		print_json_string(gcore->corename);
+		fprintf(fp, ", \"phases\": {");
+		for (i = 0; i < GCORE_PHASE_NR; i++)
+			fprintf(fp, "%s\"%s\": {\"wall\": %.6f, "
+				"\"cpu\": %.6f}", i ? ", " : "",
+				phase_names[i], gsd->phases[i].wall,
+				gsd->phases[i].cpu);
+		fprintf(fp, "}, \"pages_read\": %lu, \"pages_faulted\": %lu, "
+			"\"zero_pages\": %lu, \"pages_excluded\": %lu, "
+			"\"bytes_written\": %llu, "
+			"\"translations\": %lu, \"readmem_calls\": %lu, "
+			"\"uvtop_calls\": %lu}\n", cs->present, cs->faulted,
+			zero, cs->excluded, bytes, cs->translations,
+			gcore_counters[GCORE_COUNT_READMEM],
+			gcore_counters[GCORE_COUNT_UVTOP]);
+	}
+}
@@ -0,0 +1,979 @@
+/* gcore_writer.c -- core analysis suite
+ *
+ * Copyright (C) 2010, 2011 FUJITSU LIMITED
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <defs.h>
+#include <gcore_defs.h>
+
+/*
+ * Output backend for core files.
+ *
+ * Data is accumulated in one large, page-aligned buffer and written
+ * with pwrite() at the file offset it belongs to, so a core is
+ * written in chunks of the buffer size. Holes only move the position
+ * after flushing the buffer, and a trailing hole is materialized by
+ * ftruncate() on close. Headers that are filled in after the data
+ * following them can be written in place with gcore_writer_pwrite().
+ *
+ * Two options help when writing large cores to fast storage:
+ *
+ *   direct  page-aligned flushes go through a second descriptor
+ *           opened with O_DIRECT, so the core does not fill the page
+ *           cache; headers and the unaligned tail use the normal one.
+ *
+ *   uring   buffer flushes are submitted to an io_uring and the
+ *           writer moves on to the next of several buffers, so that
+ *           reading from the dump overlaps with writing the core.
+ *
+ * With compression, the file is a sequence of independent frames, one
+ * per buffer flush, and the writer can only move forward. Headers
+ * are written in place after the notes following them, so everything
+ * up to gcore_writer_begin_data() is kept in a memory image first.
+ * Holes are then written as zeros, and direct and uring are not used.
+ *
+ * Streaming output works the same way, so that a core can be written
+ * to a pipe, a FIFO or a character device: the headers and notes are
+ * laid out in the head image, and from gcore_writer_begin_data() on
+ * everything is written sequentially with write(), page-faulted and
+ * zero pages included as explicit zeros.
+ *
+ * All functions return TRUE on success and FALSE with errno set on
+ * failure, like gcore_elf_operations; callers raise the error.
+ */
+
+struct gcore_writer_options
+{
+	ulong bufsize;
+	int direct;
+	ulong uring_depth;	/* 0 if io_uring is not used */
+	int compress;		/* GCORE_COMPRESS_* */
+	int level;		/* 0 for the default level of the codec */
+	ulong trim_gap;		/* 0 if segments are not trimmed */
+	int dedup;
+	int resume;
+	int tolerant;
+	int stream;
+	char stream_path[CORENAME_MAX_SIZE + 1]; /* empty: core file name */
+};
+
+static struct gcore_writer_options gcore_writer_options;
+static struct gcore_writer_options *gwo = &gcore_writer_options;
+
+static int writer_flush(struct gcore_writer *w);
+static int writer_submit(struct gcore_writer *w);
+static int writer_reap(struct gcore_writer *w);
+static int writer_drain(struct gcore_writer *w);
+static int writer_fd(struct gcore_writer *w, size_t len, off_t off);
+static int writer_pwrite_all(int fd, const char *buf, size_t len, off_t off);
+static int writer_put(struct gcore_writer *w, int fd, const char *buf,
+		      size_t len, off_t off);
+static int writer_stage(struct gcore_writer *w, const void *buf, size_t len,
+			off_t off);
+static int writer_emit(struct gcore_writer *w);
+static int writer_zero(struct gcore_writer *w, off_t len);
+static int writer_seek_table(struct gcore_writer *w);
+
+/**
+ * set output options to the default
+ *
+ * Postcondition:
+ *
+ *   - The buffer size is GCORE_WRITER_DEFAULT_BUFSIZE.
+ *   - Neither O_DIRECT nor io_uring is used.
+ *   - Output is not compressed.
+ *   - Output is not streamed.
+ *   - Segments are not trimmed.
+ *   - Pages are not deduplicated across cores.
+ *   - Progress is not journaled.
+ *   - Unreadable pages abort the core.
+ */
+void gcore_writer_set_default(void)
+{
+	gwo->bufsize = GCORE_WRITER_DEFAULT_BUFSIZE;
+	gwo->direct = FALSE;
+	gwo->uring_depth = 0;
+	gwo->compress = GCORE_COMPRESS_NONE;
+	gwo->level = 0;
+	gwo->trim_gap = 0;
+	gwo->dedup = FALSE;
+	gwo->resume = FALSE;
+	gwo->tolerant = FALSE;
+	gwo->stream = FALSE;
+	gwo->stream_path[0] = '\0';
+}
+
+/**
+ * Parse a size with an optional K, M or G suffix.
+ */
+int gcore_writer_parse_size(char *s, ulong *size)
+{
+	char *end;
+	ulong value;
+
+	errno = 0;
+	value = strtoul(s, &end, 10);
+	if (errno || end == s)
+		return FALSE;
+
+	switch (*end) {
+	case 'k': case 'K':
+		value <<= 10;
+		end++;
+		break;
+	case 'm': case 'M':
+		value <<= 20;
+		end++;
+		break;
+	case 'g': case 'G':
+		value <<= 30;
+		end++;
+		break;
+	}
+
+	if (*end)
+		return FALSE;
+
+	*size = value;
+	return TRUE;
+}
+
+/**
+ * set output options
+ *
+ * @options comma-separated list of output options:
+ *
+ *   bufsize=SIZE  size of the output buffer, a multiple of PAGE_SIZE
+ *                 no larger than GCORE_WRITER_MAX_BUFSIZE; K, M and G
+ *                 suffixes are allowed.
+ *   direct        write aligned data with O_DIRECT.
+ *   uring[=N]     keep up to N, GCORE_WRITER_URING_DEPTH by default,
+ *                 buffer flushes in flight with io_uring.
+ *   compress=CODEC[:LEVEL]
+ *                 compress with zstd, lz4 or gzip, or none, one frame
+ *                 per buffer.
+ *   stream[=PATH] write strictly sequentially, to PATH if given
+ *                 instead of the core file name.
+ *   trim[=GAP]    leave page-faulted tails out of p_filesz, and split
+ *                 segments around page-faulted gaps of GAP bytes,
+ *                 GCORE_WRITER_TRIM_GAP by default, or more; K, M
+ *                 and G suffixes are allowed.
+ *   dedup         copy pages already written into an earlier core of
+ *                 the same command from there.
+ *   resume        journal the progress of the copy, and resume it
+ *                 from there if a journal is found.
+ *   tolerant      leave pages that cannot be read from the dump as
+ *                 holes, and list them in a note.
+ *
+ * Return Value:
+ *
+ *   TRUE if all the options are valid. Otherwise, FALSE; then the
+ *   options parsed before the invalid one remain set.
+ */
+int gcore_writer_set(char *options)
+{
+	char *p, *opt, *save;
+
+	p = GETBUF(strlen(options) + 1);
+	strcpy(p, options);
+
+	for (opt = strtok_r(p, ",", &save); opt;
+	     opt = strtok_r(NULL, ",", &save)) {
+		if (STRNEQ(opt, "bufsize=")) {
+			ulong size;
+
+			if (!gcore_writer_parse_size(opt + strlen("bufsize="),
+						     &size) || !size || size % PAGE_SIZE
+			    || size > GCORE_WRITER_MAX_BUFSIZE)
+				goto invalid;
+			gwo->bufsize = size;
+		} else if (STREQ(opt, "direct")) {
+			gwo->direct = TRUE;
+		} else if (STREQ(opt, "uring")) {
+			gwo->uring_depth = GCORE_WRITER_URING_DEPTH;
+		} else if (STRNEQ(opt, "uring=")) {
+			char *end;
+			ulong depth;
+
+			depth = strtoul(opt + strlen("uring="), &end, 10);
+			if (*end || depth < 2 ||
+			    depth > GCORE_WRITER_URING_MAX_DEPTH)
+				goto invalid;
+			gwo->uring_depth = depth;
+		} else if (STRNEQ(opt, "compress=")) {
+			char *name, *level, *end;
+			int codec;
+
+			name = opt + strlen("compress=");
+			if ((level = strchr(name, ':')))
+				*level++ = '\0';
+			if ((codec = gcore_compress_lookup(name)) < 0)
+				goto invalid;
+			if (!gcore_compress_available(codec)) {
+				error(INFO, "%s: not supported by this build\n",
+				      name);
+				goto invalid;
+			}
+			gwo->compress = codec;
+			gwo->level = 0;
+			if (level) {
+				gwo->level = strtol(level, &end, 10);
+				if (*end || end == level)
+					goto invalid;
+			}
+		} else if (STREQ(opt, "trim")) {
+			gwo->trim_gap = GCORE_WRITER_TRIM_GAP;
+		} else if (STRNEQ(opt, "trim=")) {
+			ulong gap;
+
+			if (!gcore_writer_parse_size(opt + strlen("trim="),
+						     &gap) || !gap || gap % PAGE_SIZE)
+				goto invalid;
+			gwo->trim_gap = gap;
+		} else if (STREQ(opt, "dedup")) {
+			gwo->dedup = TRUE;
+		} else if (STREQ(opt, "resume")) {
+			gwo->resume = TRUE;
+		} else if (STREQ(opt, "tolerant")) {
+			gwo->tolerant = TRUE;
+		} else if (STREQ(opt, "stream")) {
+			gwo->stream = TRUE;
+		} else if (STRNEQ(opt, "stream=")) {
+			char *path = opt + strlen("stream=");
+
+			if (!*path || strlen(path) > CORENAME_MAX_SIZE)
+				goto invalid;
+			gwo->stream = TRUE;
+			strcpy(gwo->stream_path, path);
+		} else
+			goto invalid;
+	}
+
+	FREEBUF(p);
+	return TRUE;
+
+invalid:
+	FREEBUF(p);
+	return FALSE;
+}
+
+/**
+ * Create @path and return a writer for it, or NULL with errno set.
+ *
+ * Output is streamed if requested, or if @path turns out not to be a
+ * regular file, such as a FIFO that a reader is waiting on.
+ *
+ * If O_DIRECT or io_uring is requested but not available for @path,
+ * a warning is printed and the writer goes on without it.
+ */
+struct gcore_writer *gcore_writer_open(const char *path)
+{
+	struct gcore_writer *w;
+	struct stat st;
+	int i, fd, flags, nbufs;
+
+	/*
+	 * A resumable core is read back to check its headers, and kept
+	 * if an earlier run left a journal.
+	 */
+	flags = gcore_writer_resume() ? O_RDWR|O_CREAT : O_WRONLY|O_CREAT;
+	if (!gcore_journal_resuming())
+		flags |= O_TRUNC;
+
+	if ((fd = open(path, flags, 0666)) < 0)
+		return NULL;
+
+	w = (struct gcore_writer *)GETBUF(sizeof(*w));
+	BZERO(w, sizeof(*w));
+	w->fd = fd;
+	w->direct_fd = -1;
+	w->bufsize = gwo->bufsize;
+
+	w->stream = gwo->stream;
+	if (fstat(fd, &st) == 0 && !S_ISREG(st.st_mode))
+		w->stream = TRUE;
+	if (w->stream) {
+		if (gwo->direct || gwo->uring_depth)
+			error(WARNING, "%s: direct and uring are not used with "
+			      "streaming\n", path);
+		w->staging = TRUE;
+	}
+
+	if (gwo->compress != GCORE_COMPRESS_NONE) {
+		if ((gwo->direct || gwo->uring_depth) && !w->stream)
+			error(WARNING, "%s: direct and uring are not used with "
+			      "compression\n", path);
+		if (!(w->compress = gcore_compress_init(gwo->compress,
+							gwo->level,
+							gcore_parallel_get()))
+		    || !(w->zbuf = malloc(w->zbufsize =
+				gcore_compress_bound(w->compress,
+						     w->bufsize)))) {
+			int err = errno;
+
+			gcore_writer_close(w);
+			errno = err ? err : ENOMEM;
+			return NULL;
+		}
+		w->staging = TRUE;
+	}
+
+	if (gwo->direct && !w->compress && !w->stream &&
+	    (w->direct_fd = open(path, O_WRONLY|O_DIRECT)) < 0)
+		error(WARNING, "%s: O_DIRECT: %s; writing through the page "
+		      "cache\n", path, strerror(errno));
+
+	if (gwo->uring_depth && !w->compress && !w->stream &&
+	    !(w->uring = gcore_uring_init(gwo->uring_depth)))
+		error(WARNING, "%s: io_uring: %s; writing synchronously\n",
+		      path, strerror(errno));
+
+	nbufs = w->uring ? gcore_uring_space(w->uring) : 1;
+	nbufs = MIN(nbufs, GCORE_WRITER_URING_MAX_DEPTH);
+
+	for (i = 0; i < nbufs; i++) {
+		void *buf;
+
+		if ((errno = posix_memalign(&buf, PAGE_SIZE, w->bufsize)))
+			break;
+		w->bufs[i].data = buf;
+		w->nbufs++;
+	}
+
+	if (!w->nbufs || (w->uring && w->nbufs < 2)) {
+		int err = errno;
+
+		gcore_writer_close(w);
+		errno = err ? err : ENOMEM;
+		return NULL;
+	}
+
+	w->buf = w->bufs[0].data;
+
+	return w;
+}
+
+/**
+ * Write @len bytes of @buf at the current position.
+ */
+int gcore_writer_write(struct gcore_writer *w, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	if (w->staging) {
+		if (!writer_stage(w, buf, len, w->pos))
+			return FALSE;
+		w->pos += len;
+		w->end = MAX(w->end, w->pos);
+		return TRUE;
+	}
+
+	while (len > 0) {
+		size_t n;
+
+		/*
+		 * Large writes bypass the buffer when it is empty,
+		 * unless the buffer is needed for alignment or has to
+		 * outlive the call, or every write has to be a frame.
+		 */
+		if (!w->len && len >= w->bufsize &&
+		    w->direct_fd < 0 && !w->uring && !w->compress) {
+			n = len - len % w->bufsize;
+			if (!writer_put(w, w->fd, p, n, w->pos))
+				return FALSE;
+			w->writes++;
+			w->bytes += n;
+			w->pos += n;
+			w->end = MAX(w->end, w->pos);
+		} else {
+			n = MIN(len, w->bufsize - w->len);
+			memcpy(w->buf + w->len, p, n);
+			w->len += n;
+			if (w->len == w->bufsize && !writer_flush(w))
+				return FALSE;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Leave a hole of @len bytes at the current position.
+ */
+int gcore_writer_skip(struct gcore_writer *w, off_t len)
+{
+	if ((w->compress || w->stream) && !w->staging)
+		return writer_zero(w, len);
+
+	if (!writer_flush(w))
+		return FALSE;
+
+	w->pos += len;
+	w->end = MAX(w->end, w->pos);
+
+	return TRUE;
+}
+
+/**
+ * Move the current position to @offset. With compression or
+ * streaming, only forward moves are possible after
+ * gcore_writer_begin_data().
+ */
+int gcore_writer_seek(struct gcore_writer *w, off_t offset)
+{
+	if ((w->compress || w->stream) && !w->staging) {
+		if (offset < gcore_writer_tell(w)) {
+			errno = ESPIPE;
+			return FALSE;
+		}
+		return writer_zero(w, offset - gcore_writer_tell(w));
+	}
+
+	if (!writer_flush(w))
+		return FALSE;
+
+	w->pos = offset;
+	w->end = MAX(w->end, w->pos);
+
+	return TRUE;
+}
+
+/**
+ * Return the current position.
+ */
+off_t gcore_writer_tell(struct gcore_writer *w)
+{
+	return w->pos + w->len;
+}
+
+/**
+ * Write @len bytes of @buf at @offset without moving the current
+ * position. If the range overlaps with buffered data, the buffer is
+ * flushed first, and writes in flight are always completed first.
+ *
+ * With compression or streaming, @offset must be within the buffered
+ * data once gcore_writer_begin_data() has been called.
+ */
+int gcore_writer_pwrite(struct gcore_writer *w, const void *buf, size_t len,
+			off_t offset)
+{
+	if (w->staging) {
+		if (!writer_stage(w, buf, len, offset))
+			return FALSE;
+		w->end = MAX(w->end, offset + len);
+		return TRUE;
+	}
+
+	if (w->compress || w->stream) {
+		if (offset < w->pos || offset + len > w->pos + w->len) {
+			errno = ESPIPE;
+			return FALSE;
+		}
+		memcpy(w->buf + (offset - w->pos), buf, len);
+		return TRUE;
+	}
+
+	if (w->len && offset < w->pos + w->len && w->pos < offset + len &&
+	    !writer_flush(w))
+		return FALSE;
+
+	if (!writer_drain(w))
+		return FALSE;
+
+	if (!writer_pwrite_all(w->fd, buf, len, offset))
+		return FALSE;
+
+	w->writes++;
+	w->bytes += len;
+	w->end = MAX(w->end, offset + len);
+
+	return TRUE;
+}
+
+/**
+ * Write out buffered data and wait for writes in flight; the caller
+ * may then write into the file descriptor directly with pwrite().
+ */
+int gcore_writer_flush(struct gcore_writer *w)
+{
+	return writer_flush(w) && writer_drain(w);
+}
+
+/**
+ * Return the file descriptor to pwrite() data into, or -1 if the
+ * data has to go through the writer.
+ */
+int gcore_writer_fd(struct gcore_writer *w)
+{
+	return (w->compress || w->stream) ? -1 : w->fd;
+}
+
+/**
+ * Tell the writer that all the headers have been written and only
+ * data follows from the current position on.
+ *
+ * With compression or streaming, the memory image of the headers is
+ * written out first; otherwise, this does nothing.
+ */
+int gcore_writer_begin_data(struct gcore_writer *w)
+{
+	off_t pos = w->pos;
+	int ret;
+
+	if (!w->staging)
+		return TRUE;
+
+	if (w->end > pos) {
+		errno = EINVAL;
+		return FALSE;
+	}
+
+	w->staging = FALSE;
+	w->pos = w->end = 0;
+
+	ret = writer_stage(w, NULL, 0, pos) &&
+		gcore_writer_write(w, w->head, pos);
+
+	free(w->head);
+	w->head = NULL;
+	w->head_size = 0;
+
+	return ret;
+}
+
+/**
+ * Return the suffix to append to core file names, which depends on
+ * the compression requested.
+ */
+const char *gcore_writer_suffix(void)
+{
+	return gcore_compress_suffix(gwo->compress);
+}
+
+/**
+ * Return the smallest page-faulted gap to split a segment around, or
+ * 0 if segments are not trimmed.
+ */
+ulong gcore_writer_trim_gap(void)
+{
+	return gwo->trim_gap;
+}
+
+/**
+ * Return TRUE if pages are to be deduplicated across cores.
+ */
+int gcore_writer_dedup(void)
+{
+	return gwo->dedup;
+}
+
+/**
+ * Return TRUE if the progress of the copy is to be journaled. Only
+ * plain core files, neither compressed nor streamed, can be resumed.
+ * Nor can tolerant ones: the pages left as holes before the resume
+ * point are not journaled, and would be missing from the note.
+ */
+int gcore_writer_resume(void)
+{
+	return gwo->resume && gwo->compress == GCORE_COMPRESS_NONE &&
+		!gwo->stream && !gwo->tolerant;
+}
+
+/**
+ * Return TRUE if pages that cannot be read are to be left as holes.
+ */
+int gcore_writer_tolerant(void)
+{
+	return gwo->tolerant;
+}
+
+/**
+ * Return the path given with stream=PATH, which replaces the core
+ * file name, or NULL.
+ */
+const char *gcore_writer_stream_path(void)
+{
+	return gwo->stream_path[0] ? gwo->stream_path : NULL;
+}
+
+/**
+ * Flush buffered data, extend the file up to the last hole and close
+ * it. The writer must not be used any more, whether this succeeds or
+ * not.
+ */
+int gcore_writer_close(struct gcore_writer *w)
+{
+	struct stat st;
+	int i, ret = TRUE;
+
+	if (w->compress) {
+		if (w->zbuf &&
+		    (!gcore_writer_begin_data(w) || !gcore_writer_flush(w) ||
+		     !writer_seek_table(w)))
+			ret = FALSE;
+	} else if (w->stream) {
+		if (w->nbufs &&
+		    (!gcore_writer_begin_data(w) || !gcore_writer_flush(w)))
+			ret = FALSE;
+	} else if (!gcore_writer_flush(w))
+		ret = FALSE;
+	else if (fstat(w->fd, &st) < 0)
+		ret = FALSE;
+	else if (st.st_size < w->end && ftruncate(w->fd, w->end) < 0)
+		ret = FALSE;
+
+	if (close(w->fd) < 0 && ret)
+		ret = FALSE;
+	if (w->direct_fd >= 0)
+		close(w->direct_fd);
+	if (w->uring)
+		gcore_uring_exit(w->uring);
+
+	for (i = 0; i < w->nbufs; i++)
+		free(w->bufs[i].data);
+	w->nbufs = 0;
+	w->buf = NULL;
+	w->uring = NULL;
+	w->fd = w->direct_fd = -1;
+
+	if (w->compress)
+		gcore_compress_exit(w->compress);
+	free(w->zbuf);
+	free(w->head);
+	free(w->frames);
+	w->compress = NULL;
+	w->zbuf = w->head = NULL;
+	w->frames = NULL;
+
+	return ret;
+}
+
+/**
+ * Return how many bytes have been written so far.
+ */
+ulonglong gcore_writer_bytes(struct gcore_writer *w)
+{
+	return w->bytes;
+}
+
+/**
+ * Print how many bytes have been written with how many writes.
+ */
+void gcore_writer_report(struct gcore_writer *w)
+{
+	progressf("Wrote %llu bytes in %lu writes of up to %lu bytes\n",
+		  w->bytes, w->writes, (ulong)w->bufsize);
+	if (w->direct_fd >= 0)
+		progressf("  %lu writes with O_DIRECT\n", w->direct_writes);
+	if (w->uring)
+		progressf("  up to %d writes in flight with io_uring\n",
+			  w->nbufs);
+	if (w->compress)
+		progressf("  %lu frames holding %llu bytes of core file\n",
+			  w->nr_frames, (ulonglong)w->end);
+	if (w->stream)
+		progressf("  streamed sequentially\n");
+}
+
+static int writer_flush(struct gcore_writer *w)
+{
+	if (!w->len || w->staging)
+		return TRUE;
+
+	if (w->compress) {
+		if (!writer_emit(w))
+			return FALSE;
+	} else if (w->uring) {
+		if (!writer_submit(w))
+			return FALSE;
+	} else if (!writer_put(w, writer_fd(w, w->len, w->pos), w->buf,
+			       w->len, w->pos))
+		return FALSE;
+
+	if (!w->compress) {
+		w->writes++;
+		w->bytes += w->len;
+	}
+
+	w->pos += w->len;
+	w->end = MAX(w->end, w->pos);
+	w->len = 0;
+
+	return TRUE;
+}
+
+/*
+ * Choose the descriptor for writing @len bytes at @off from an output
+ * buffer.
+ */
+static int writer_fd(struct gcore_writer *w, size_t len, off_t off)
+{
+	if (w->direct_fd >= 0 && !(len % PAGE_SIZE) && !(off % PAGE_SIZE)) {
+		w->direct_writes++;
+		return w->direct_fd;
+	}
+
+	return w->fd;
+}
+
+/*
+ * Submit the current buffer and switch to a free one, waiting for a
+ * write in flight to complete if all the buffers are busy.
+ */
+static int writer_submit(struct gcore_writer *w)
+{
+	struct gcore_writer_buffer *b = &w->bufs[w->cur];
+	int i;
+
+	b->fd = writer_fd(w, w->len, w->pos);
+	b->len = w->len;
+	b->offset = w->pos;
+
+	if (!gcore_uring_write(w->uring, b->fd, b->data, b->len, b->offset,
+			       w->cur))
+		return FALSE;
+	b->busy = TRUE;
+
+	for (;;) {
+		for (i = 0; i < w->nbufs; i++) {
+			if (!w->bufs[i].busy) {
+				w->cur = i;
+				w->buf = w->bufs[i].data;
+				return TRUE;
+			}
+		}
+		if (!writer_reap(w))
+			return FALSE;
+	}
+}
+
+/*
+ * Wait for one write in flight. A short write is completed
+ * synchronously, as is a write the kernel cannot do with io_uring.
+ */
+static int writer_reap(struct gcore_writer *w)
+{
+	struct gcore_writer_buffer *b;
+	ulong index;
+	int res;
+
+	if (!gcore_uring_wait(w->uring, &index, &res))
+		return FALSE;
+
+	b = &w->bufs[index];
+	b->busy = FALSE;
+
+	if (res == -EINVAL || res == -EOPNOTSUPP)
+		res = 0;
+	else if (res < 0) {
+		errno = -res;
+		return FALSE;
+	}
+
+	if (res < b->len &&
+	    !writer_pwrite_all(b->fd, b->data + res, b->len - res,
+			       b->offset + res))
+		return FALSE;
+
+	return TRUE;
+}
+
+static int writer_drain(struct gcore_writer *w)
+{
+	int i;
+
+	if (!w->uring)
+		return TRUE;
+
+	for (i = 0; i < w->nbufs; i++)
+		while (w->bufs[i].busy)
+			if (!writer_reap(w))
+				return FALSE;
+
+	return TRUE;
+}
+
+static int writer_pwrite_all(int fd, const char *buf, size_t len, off_t off)
+{
+	while (len > 0) {
+		ssize_t n = pwrite(fd, buf, len, off);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		buf += n;
+		off += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Write @len bytes of @buf at @off of the file descriptor. A stream
+ * is written sequentially, so @off is always where it stands already.
+ */
+static int writer_put(struct gcore_writer *w, int fd, const char *buf,
+		      size_t len, off_t off)
+{
+	if (!w->stream)
+		return writer_pwrite_all(fd, buf, len, off);
+
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Copy @len bytes of @buf at @off of the head image, growing the image
+ * with zeros as needed.
+ */
+static int writer_stage(struct gcore_writer *w, const void *buf, size_t len,
+			off_t off)
+{
+	if (off + len > w->head_size) {
+		size_t size = MAX(off + len, 2 * w->head_size);
+		char *head;
+
+		size = roundup(size, PAGE_SIZE);
+		if (!(head = realloc(w->head, size)))
+			return FALSE;
+		memset(head + w->head_size, 0, size - w->head_size);
+		w->head = head;
+		w->head_size = size;
+	}
+
+	if (len)
+		memcpy(w->head + off, buf, len);
+
+	return TRUE;
+}
+
+/*
+ * Compress the buffer into one frame and write it out.
+ */
+static int writer_emit(struct gcore_writer *w)
+{
+	struct gcore_writer_frame *f;
+	size_t n;
+
+	if (w->nr_frames == w->max_frames) {
+		ulong max = w->max_frames ? 2 * w->max_frames : 1024;
+
+		if (!(f = realloc(w->frames, max * sizeof(*f))))
+			return FALSE;
+		w->frames = f;
+		w->max_frames = max;
+	}
+
+	if (!(n = gcore_compress_frame(w->compress, w->zbuf, w->zbufsize,
+				       w->buf, w->len)))
+		return FALSE;
+
+	if (!writer_put(w, w->fd, w->zbuf, n, w->zpos))
+		return FALSE;
+
+	f = &w->frames[w->nr_frames++];
+	f->compressed = n;
+	f->decompressed = w->len;
+
+	w->zpos += n;
+	w->writes++;
+	w->bytes += n;
+
+	return TRUE;
+}
+
+/*
+ * Write @len bytes of zeros, for a hole in compressed output.
+ */
+static int writer_zero(struct gcore_writer *w, off_t len)
+{
+	while (len > 0) {
+		size_t n = MIN(len, w->bufsize - w->len);
+
+		memset(w->buf + w->len, 0, n);
+		w->len += n;
+		len -= n;
+		if (w->len == w->bufsize && !writer_flush(w))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void put_le32(unsigned char *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/*
+ * Append the seek table of the frames written so far, in the zstd
+ * seekable format.
+ */
+static int writer_seek_table(struct gcore_writer *w)
+{
+	unsigned char *table, *p;
+	size_t size;
+	ulong i;
+	int ret;
+
+	if (!gcore_compress_seekable(w->compress))
+		return TRUE;
+
+	/* skippable frame header, entries, footer */
+	size = 8 + w->nr_frames * 8 + 9;
+	if (!(table = malloc(size)))
+		return FALSE;
+
+	p = table;
+	put_le32(p, GCORE_SKIPPABLE_MAGIC);
+	put_le32(p + 4, size - 8);
+	p += 8;
+	for (i = 0; i < w->nr_frames; i++, p += 8) {
+		put_le32(p, w->frames[i].compressed);
+		put_le32(p + 4, w->frames[i].decompressed);
+	}
+	put_le32(p, w->nr_frames);
+	p[4] = 0;		/* no checksums */
+	put_le32(p + 5, GCORE_SEEKABLE_MAGIC);
+
+	ret = writer_put(w, w->fd, (char *)table, size, w->zpos);
+	if (ret) {
+		w->zpos += size;
+		w->writes++;
+		w->bytes += size;
+	}
+
+	free(table);
+
+	return ret;
+}
@@ -286,21 +286,44 @@ union thread_xstate {
 #define TS_USEDFPU		0x0001	/* FPU was used by this task
 					   this quantum (SMP) */
 
+/*
+ * CPU features and the xstate layout do not change within a dump
+ * file, yet they are checked for every thread by the regsets. Each is
+ * looked up on first use and then kept for the rest of the session.
+ */
+struct gcore_x86_cpu_data
+{
+	int has_capability;
+	uint32_t x86_capability[NCAPINTS];
+	int xstate_regsets_number;	/* -1 until looked up */
+	int has_fx_sw_bytes;		/* -1 until looked up */
+	uint64_t fx_sw_bytes[USER_XSTATE_FX_SW_WORDS];
+};
+
+static struct gcore_x86_cpu_data gcore_x86_cpu_data = {
+	.xstate_regsets_number = -1,
+	.has_fx_sw_bytes = -1,
+};
+static struct gcore_x86_cpu_data *gxc = &gcore_x86_cpu_data;
+
 static int
 boot_cpu_has(int feature)
 {
-	uint32_t x86_capability[NCAPINTS];
+	if (!gxc->has_capability) {
+		if (!symbol_exists("boot_cpu_data"))
+			error(FATAL, "boot_cpu_data: symbol does not exist\n");
 
-	if (!symbol_exists("boot_cpu_data"))
-		error(FATAL, "boot_cpu_data: symbol does not exist\n");
+		readmem(symbol_value("boot_cpu_data") +
+			GCORE_OFFSET(cpuinfo_x86_x86_capability), KVADDR,
+			&gxc->x86_capability, sizeof(gxc->x86_capability),
+			"boot_cpu_has: x86_capability",
+			gcore_verbose_error_handle());
 
-	readmem(symbol_value("boot_cpu_data") +
-		GCORE_OFFSET(cpuinfo_x86_x86_capability), KVADDR,
-		&x86_capability, sizeof(x86_capability),
-		"boot_cpu_has: x86_capability",
-		gcore_verbose_error_handle());
+		gxc->has_capability = TRUE;
+	}
 
-	return ((1UL << (feature % 32)) & x86_capability[feature / 32]) != 0;
+	return ((1UL << (feature % 32)) &
+		gxc->x86_capability[feature / 32]) != 0;
 }
 
 static inline int
@@ -350,6 +373,25 @@ init_fpu(ulong task)
         }
 }
 
+/*
+ * Read the FPU state of @target. When it is embedded in task_struct,
+ * it comes from the same snapshot as the other thread_struct fields.
+ */
+static void
+read_thread_struct_fpu(struct task_context *target, void *buf, long size,
+		       char *type_string)
+{
+	ulong fpu = gxt->get_thread_struct_fpu(target);
+
+	if (fpu >= target->task)
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			fpu - target->task, buf, size, type_string,
+			gcore_verbose_error_handle());
+	else
+		gcore_objcache_readmem(GCORE_OBJ_FPU, fpu, 0, buf, size,
+			type_string, gcore_verbose_error_handle());
+}
+
 static int
 xfpregs_active(struct task_context *target,
 	       const struct user_regset *regset)
@@ -364,9 +406,8 @@ static int xfpregs_get(struct task_context *target,
 {
 	union thread_xstate xstate;
 
-	readmem(gxt->get_thread_struct_fpu(target), KVADDR, &xstate,
-		sizeof(xstate),
-		"xfpregs_get: xstate", gcore_verbose_error_handle());
+	read_thread_struct_fpu(target, &xstate, sizeof(xstate),
+			       "xfpregs_get: xstate");
 	memcpy(buf, &xstate.fsave, MIN(size, sizeof(xstate.fsave)));
 
 	init_fpu(target->task);
@@ -491,9 +532,8 @@ convert_from_fxsr(struct user_i387_ia32_struct *env, struct task_context *target
 	struct _fpxreg *from;
 	int i;
 
-	readmem(gxt->get_thread_struct_fpu(target), KVADDR, &xstate,
-		sizeof(xstate), "convert_from_fxsr: xstate",
-		gcore_verbose_error_handle());
+	read_thread_struct_fpu(target, &xstate, sizeof(xstate),
+			       "convert_from_fxsr: xstate");
 
 	to = (struct _fpreg *) &env->st_space[0];
 	from = (struct _fpxreg *) &xstate.fxsave.st_space[0];
@@ -514,14 +554,15 @@ convert_from_fxsr(struct user_i387_ia32_struct *env, struct task_context *target
 
 		pt_regs_buf = GETBUF(SIZE(pt_regs));
 
-		readmem(machdep->get_stacktop(target->task) - SIZE(pt_regs),
-			KVADDR,	pt_regs_buf, SIZE(pt_regs),
-			"convert_from_fxsr: regs",
+		gcore_objcache_readmem(GCORE_OBJ_PT_REGS,
+			gcore_arch_user_regs(target), 0, pt_regs_buf,
+			SIZE(pt_regs), "convert_from_fxsr: regs",
 			gcore_verbose_error_handle());
 
-		readmem(target->task + OFFSET(task_struct_thread)
-			+ GCORE_OFFSET(thread_struct_ds), KVADDR, &ds,
-			sizeof(ds), "convert_from_fxsr: ds",
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_ds),
+			&ds, sizeof(ds), "convert_from_fxsr: ds",
 			gcore_verbose_error_handle());
 			
 		env->fos = 0xffff0000 | ds;
@@ -555,9 +596,8 @@ static int fpregs_get(struct task_context *target,
 		return fpregs_soft_get(target, regset, size, buf);
 
 	if (!cpu_has_fxsr()) {
-		readmem(gxt->get_thread_struct_fpu(target), KVADDR, &xstate,
-			sizeof(xstate),
-			"fpregs_get: xstate", gcore_verbose_error_handle());
+		read_thread_struct_fpu(target, &xstate, sizeof(xstate),
+				       "fpregs_get: xstate");
 		memcpy(buf, &xstate.fsave, MIN(size, sizeof(xstate.fsave)));
 		return 0;
 	}
@@ -581,9 +621,10 @@ static ulong gcore_x86_get_thread_struct_fpu_thread_xstate(struct task_context *
 {
 	ulong state;
 
-	readmem(tc->task + OFFSET(task_struct_thread)
-		+ GCORE_OFFSET(thread_struct_fpu) + GCORE_OFFSET(fpu_state),
-		KVADDR, &state, sizeof(state),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_fpu) +
+		GCORE_OFFSET(fpu_state),
+		&state, sizeof(state),
 		"gcore_x86_get_thread_struct_fpu_thread_xstate: state",
 		gcore_verbose_error_handle());
 
@@ -603,9 +644,9 @@ static ulong gcore_x86_get_thread_struct_thread_xstate(struct task_context *tc)
 {
 	ulong xstate;
 
-	readmem(tc->task + OFFSET(task_struct_thread)
-		+ GCORE_OFFSET(thread_struct_xstate), KVADDR, &xstate,
-		sizeof(xstate),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_xstate),
+		&xstate, sizeof(xstate),
 		"gcore_x86_get_thread_struct_thread_xstate: xstate",
 		gcore_verbose_error_handle());
 
@@ -638,6 +679,11 @@ static int get_xstate_regsets_number(void)
 	ulong x86_64_regsets_xstate;
 	unsigned int n;
 
+	if (gxc->xstate_regsets_number >= 0)
+		return gxc->xstate_regsets_number;
+
+	gxc->xstate_regsets_number = 0;
+
 	if (!symbol_exists("REGSET_XSTATE"))
 		return 0;
 
@@ -652,15 +698,35 @@ static int get_xstate_regsets_number(void)
 	readmem(x86_64_regsets_xstate + GCORE_OFFSET(user_regset_n),
 		KVADDR, &n, sizeof(n), "fpregs_active: n", FAULT_ON_ERROR);
 
+	gxc->xstate_regsets_number = n;
+
 	return n;
 }
 
+/*
+ * The 48 bytes defined by the software in the xstate layout are the
+ * same for every thread.
+ */
+static int has_xstate_fx_sw_bytes(void)
+{
+	if (gxc->has_fx_sw_bytes < 0) {
+		gxc->has_fx_sw_bytes = symbol_exists("xstate_fx_sw_bytes");
+		if (gxc->has_fx_sw_bytes)
+			readmem(symbol_value("xstate_fx_sw_bytes"), KVADDR,
+				gxc->fx_sw_bytes, sizeof(gxc->fx_sw_bytes),
+				"fill_xstate: sw_reserved",
+				gcore_verbose_error_handle());
+	}
+
+	return gxc->has_fx_sw_bytes;
+}
+
 static inline int
 xstateregs_active(struct task_context *target,
 		  const struct user_regset *regset)
 {
 	return cpu_has_xsave() && fpregs_active(target, regset)
-		&& symbol_exists("xstate_fx_sw_bytes")
+		&& has_xstate_fx_sw_bytes()
 		&& !!get_xstate_regsets_number();
 }
 
@@ -671,25 +737,23 @@ xstateregs_get(struct task_context *target,
 	       void *buf)
 {
 	union thread_xstate *xstate = (union thread_xstate *)buf;
-	ulong xstate_fx_sw_bytes;
 
-	readmem(target->task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_xstate), KVADDR, xstate,
-		sizeof(union thread_xstate), "xstateregs_get: thread",
+	gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_xstate),
+		xstate, sizeof(union thread_xstate), "xstateregs_get: thread",
 		gcore_verbose_error_handle());
 
         init_fpu(target->task);
 
-	xstate_fx_sw_bytes = symbol_value("xstate_fx_sw_bytes");
+	has_xstate_fx_sw_bytes();
 
         /*
          * Copy the 48bytes defined by the software first into the xstate
          * memory layout in the thread struct, so that we can copy the entire
          * xstateregs to the user using one user_regset_copyout().
          */
-	readmem(xstate_fx_sw_bytes, KVADDR, &xstate->fxsave.sw_reserved,
-		USER_XSTATE_FX_SW_WORDS * sizeof(uint64_t),
-		"fill_xstate: sw_reserved", gcore_verbose_error_handle());
+	memcpy(&xstate->fxsave.sw_reserved, gxc->fx_sw_bytes,
+	       sizeof(gxc->fx_sw_bytes));
 
 	return 0;
 }
@@ -787,11 +851,11 @@ static int regset_tls_active(struct task_context *target,
 
 	tls_array = (struct desc_struct *)GETBUF(GCORE_SIZE(thread_struct_tls_array));
 
-	readmem(target->task + OFFSET(task_struct_thread)
-		+ GCORE_OFFSET(thread_struct_tls_array), KVADDR,
+	gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+		OFFSET(task_struct_thread) +
+		GCORE_OFFSET(thread_struct_tls_array),
 		tls_array, GCORE_SIZE(thread_struct_tls_array),
-		"regset_tls_active: t",
-		gcore_verbose_error_handle());
+		"regset_tls_active: t", gcore_verbose_error_handle());
 
 	for (i = 0; i < nr_entries; ++i) {
 		if (!desc_empty(&tls_array[i])) {
@@ -817,11 +881,11 @@ static int regset_tls_get(struct task_context *target,
 
 	tls_array = (struct desc_struct *)GETBUF(GCORE_SIZE(thread_struct_tls_array));
 
-	readmem(target->task + OFFSET(task_struct_thread)
-		+ GCORE_OFFSET(thread_struct_tls_array), KVADDR,
+	gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+		OFFSET(task_struct_thread) +
+		GCORE_OFFSET(thread_struct_tls_array),
 		tls_array, GCORE_SIZE(thread_struct_tls_array),
-		"regset_tls_active: tls_array",
-		gcore_verbose_error_handle());
+		"regset_tls_active: tls_array", gcore_verbose_error_handle());
 
 	for (i = 0; i < nr_entries; ++i) {
 		fill_user_desc(&info[i], GDT_ENTRY_TLS_MIN + i, &tls_array[i]);
@@ -844,20 +908,23 @@ ioperm_active(struct task_context *target,
 	ulong io_bitmap;
 
 	if (MEMBER_EXISTS("thread_struct", "io_bitmap_max")) {
-		readmem(target->task + OFFSET(task_struct_thread) +
-			GCORE_OFFSET(thread_struct_io_bitmap_max), KVADDR,
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_io_bitmap_max),
 			&io_bitmap_max, sizeof(io_bitmap_max),
 			"ioperm_active: io_bitmap_max",
 			gcore_verbose_error_handle());
-		readmem(target->task + OFFSET(task_struct_thread) +
-			GCORE_OFFSET(thread_struct_io_bitmap_ptr), KVADDR,
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_io_bitmap_ptr),
 			&io_bitmap_ptr, sizeof(io_bitmap_ptr),
 			"ioperm_get: io_bitmap_ptr",
 			gcore_verbose_error_handle());
 		return io_bitmap_max && io_bitmap_ptr;
 	} else {
-		readmem(target->task + OFFSET(task_struct_thread) +
-			MEMBER_OFFSET("thread_struct", "io_bitmap"), KVADDR,
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			MEMBER_OFFSET("thread_struct", "io_bitmap"),
 			&io_bitmap, sizeof(io_bitmap),
 			"ioperm_active: io_bitmap",
 			gcore_verbose_error_handle());
@@ -881,13 +948,16 @@ static int ioperm_get(struct task_context *target,
 	ulong io_bitmap;
 
 	if (MEMBER_EXISTS("thread_struct", "io_bitmap_max")) {
-		readmem(target->task + OFFSET(task_struct_thread) +
-			GCORE_OFFSET(thread_struct_io_bitmap_ptr), KVADDR,
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_io_bitmap_ptr),
 			&io_bitmap_ptr, sizeof(io_bitmap_ptr),
-			"ioperm_get: io_bitmap_ptr", gcore_verbose_error_handle());
+			"ioperm_get: io_bitmap_ptr",
+			gcore_verbose_error_handle());
 	} else {
-		readmem(target->task + OFFSET(task_struct_thread) +
-			MEMBER_OFFSET("thread_struct", "io_bitmap"), KVADDR,
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			MEMBER_OFFSET("thread_struct", "io_bitmap"),
 			&io_bitmap, sizeof(io_bitmap),
 			"ioperm_active: io_bitmap",
 			gcore_verbose_error_handle());
@@ -930,6 +1000,8 @@ static int is_special_syscall_v0(int nr_syscall)
 #define IA32_SYSCALL_VECTOR 0x80
 
 #define __KERNEL_CS 0x10
+#define __KERNEL_DS 0x18
+#define __USER32_CS 0x23
 #endif
 
 //extern struct gate_struct idt_table[]; 
@@ -1059,13 +1131,10 @@ static int tsk_used_math_v4_14(ulong task)
 	if (!cpu_has_fxsr())
 		return 0;
 
-	readmem(task +
-		OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_fpu) +
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_fpu) +
 		MEMBER_OFFSET("fpu", "initialized"),
-		KVADDR,
-		&initialized,
-		sizeof(initialized),
+		&initialized, sizeof(initialized),
 		"tsk_used_math_v4_14: initialized",
 		gcore_verbose_error_handle());
 
@@ -1097,15 +1166,16 @@ test_tsk_thread_flag(ulong task, int bit)
 static void
 restore_segment_registers(ulong task, struct user_regs_struct *regs)
 {
-	readmem(task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_fs), KVADDR, &regs->fs_base,
-		GCORE_SIZE(thread_struct_fs),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_fs),
+		&regs->fs_base, GCORE_SIZE(thread_struct_fs),
 		"restore_segment_registers: fs", gcore_verbose_error_handle());
 
 	if (!regs->fs_base) {
 
-		readmem(task + OFFSET(task_struct_thread) +
-			GCORE_OFFSET(thread_struct_fsindex), KVADDR,
+		gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_fsindex),
 			&regs->fs_base, GCORE_SIZE(thread_struct_fsindex),
 			"restore_segment_registers: fsindex",
 			gcore_verbose_error_handle());
@@ -1115,9 +1185,10 @@ restore_segment_registers(ulong task, struct user_regs_struct *regs)
 		else {
 			struct desc_struct desc;
 
-			readmem(task + OFFSET(task_struct_thread) +
-				FS_TLS * SIZE(desc_struct), KVADDR, &desc,
-				sizeof(desc),
+			gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+				OFFSET(task_struct_thread) +
+				FS_TLS * SIZE(desc_struct),
+				&desc, sizeof(desc),
 				"restore_segment_registers: desc",
 				gcore_verbose_error_handle());
 
@@ -1125,26 +1196,31 @@ restore_segment_registers(ulong task, struct user_regs_struct *regs)
 		}
 	}
 
-	readmem(task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_gsindex), KVADDR, &regs->gs_base,
-		GCORE_SIZE(thread_struct_gsindex),
-		"restore_segment_registers: gsindex", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) +
+		GCORE_OFFSET(thread_struct_gsindex),
+		&regs->gs_base, GCORE_SIZE(thread_struct_gsindex),
+		"restore_segment_registers: gsindex",
+		gcore_verbose_error_handle());
 
 	if (!regs->gs_base) {
 
-		readmem(task + OFFSET(task_struct_thread) +
-			GCORE_OFFSET(thread_struct_gs), KVADDR,	&regs->gs_base,
-			GCORE_SIZE(thread_struct_gs),
-			"restore_segment_registers: gs", gcore_verbose_error_handle());
+		gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_gs),
+			&regs->gs_base, GCORE_SIZE(thread_struct_gs),
+			"restore_segment_registers: gs",
+			gcore_verbose_error_handle());
 
 		if (regs->gs_base != GS_TLS_SEL)
 			regs->gs_base = 0;
 		else {
 			struct desc_struct desc;
 
-			readmem(task + OFFSET(task_struct_thread) +
-				GS_TLS * SIZE(desc_struct), KVADDR, &desc,
-				sizeof(desc),
+			gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+				OFFSET(task_struct_thread) +
+				GS_TLS * SIZE(desc_struct),
+				&desc, sizeof(desc),
 				"restore_segment_registers: desc",
 				gcore_verbose_error_handle());
 
@@ -1155,29 +1231,29 @@ restore_segment_registers(ulong task, struct user_regs_struct *regs)
 	if (test_tsk_thread_flag(task, TIF_FORCED_TF))
 		regs->flags &= ~X86_EFLAGS_TF;
 
-	readmem(task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_fsindex), KVADDR, &regs->fs,
-		GCORE_SIZE(thread_struct_fsindex),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) +
+		GCORE_OFFSET(thread_struct_fsindex),
+		&regs->fs, GCORE_SIZE(thread_struct_fsindex),
 		"restore_segment_registers: fsindex",
 		gcore_verbose_error_handle());
 
-	readmem(task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_gsindex), KVADDR, &regs->gs,
-		GCORE_SIZE(thread_struct_gsindex),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) +
+		GCORE_OFFSET(thread_struct_gsindex),
+		&regs->gs, GCORE_SIZE(thread_struct_gsindex),
 		"restore_segment_registers: gsindex",
 		gcore_verbose_error_handle());
 
-	readmem(task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_ds), KVADDR, &regs->ds,
-		GCORE_SIZE(thread_struct_ds),
-		"restore_segment_registers: ds",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_ds),
+		&regs->ds, GCORE_SIZE(thread_struct_ds),
+		"restore_segment_registers: ds", gcore_verbose_error_handle());
 
-	readmem(task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_es), KVADDR, &regs->es,
-		GCORE_SIZE(thread_struct_es),
-		"restore_segment_registers: es",
-		gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_es),
+		&regs->es, GCORE_SIZE(thread_struct_es),
+		"restore_segment_registers: es", gcore_verbose_error_handle());
 
 	regs->flags &= 0xffff;
 	regs->fs_base &= 0xffff;
@@ -1211,9 +1287,10 @@ static ulong restore_frame_pointer(ulong task)
 	/*
 	 * rsp is saved in task->thread.sp during switch_to().
 	 */
-	readmem(task + OFFSET(task_struct_thread) +
-		OFFSET(thread_struct_rsp), KVADDR, &rsp, sizeof(rsp),
-		"restore_frame_pointer: rsp", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+		OFFSET(task_struct_thread) + OFFSET(thread_struct_rsp), &rsp,
+		sizeof(rsp), "restore_frame_pointer: rsp",
+		gcore_verbose_error_handle());
 
 	/*
 	 * rbp is saved at the point referred to by rsp
@@ -1347,9 +1424,9 @@ static inline void restore_rest(ulong task, struct user_regs_struct *regs,
 
 		memset(&frame, 0, sizeof(frame));
 
-		readmem(task + OFFSET(task_struct_thread) +
-			OFFSET(thread_struct_rsp), KVADDR, &rsp, sizeof(rsp),
-			"restore_rest: rsp",
+		gcore_objcache_readmem(GCORE_OBJ_TASK, task,
+			OFFSET(task_struct_thread) + OFFSET(thread_struct_rsp),
+			&rsp, sizeof(rsp), "restore_rest: rsp",
 			gcore_verbose_error_handle());
 		readmem(rsp, KVADDR, &rbp, sizeof(rbp), "restore_rest: rbp",
 			gcore_verbose_error_handle());
@@ -1511,9 +1588,9 @@ static ulong gcore_x86_64_user_stack_pointer_userrsp(struct task_context *tc)
 	if (is_task_active(tc->task))
 		return gxt->get_old_rsp(tc->processor);
 
-	readmem(tc->task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_usersp), KVADDR, &usersp,
-		sizeof(usersp),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_usersp),
+		&usersp, sizeof(usersp),
 		"gcore_x86_64_user_stack_pointer_userrsp: usersp",
 		gcore_verbose_error_handle());
 
@@ -1528,9 +1605,9 @@ static ulong gcore_x86_64_user_stack_pointer_pt_regs(struct task_context *tc)
 
 	pt_regs_buf = GETBUF(SIZE(pt_regs));
 
-	readmem(tc->task + OFFSET(task_struct_thread) +
-		GCORE_OFFSET(thread_struct_sp0), KVADDR, &sp0,
-		sizeof(sp0),
+	gcore_objcache_readmem(GCORE_OBJ_TASK, tc->task,
+		OFFSET(task_struct_thread) + GCORE_OFFSET(thread_struct_sp0),
+		&sp0, sizeof(sp0),
 		"gcore_x86_64_user_stack_pointer_pt_regs: sp0",
 		gcore_verbose_error_handle());
 
@@ -1581,6 +1658,117 @@ gcore_get_regs_from_bt_output(FILE *output, struct user_regs_struct *regs)
 	return TRUE;
 }
 
+/*
+ * Decode the pt_regs structure in @pt_regs_buf into @regs.
+ */
+static void
+gcore_pt_regs_to_user_regs(const char *pt_regs_buf,
+			   struct user_regs_struct *regs)
+{
+	struct machine_specific *ms = machdep->machspec;
+
+	regs->ip = ULONG(pt_regs_buf + ms->pto.rip);
+	regs->sp = ULONG(pt_regs_buf + ms->pto.rsp);
+	regs->cs = ULONG(pt_regs_buf + ms->pto.cs);
+	regs->ss = ULONG(pt_regs_buf + ms->pto.ss);
+	regs->flags = ULONG(pt_regs_buf + ms->pto.eflags);
+	regs->orig_ax = ULONG(pt_regs_buf + ms->pto.orig_rax);
+	regs->bp = ULONG(pt_regs_buf + ms->pto.rbp);
+	regs->ax = ULONG(pt_regs_buf + ms->pto.rax);
+	regs->bx = ULONG(pt_regs_buf + ms->pto.rbx);
+	regs->cx = ULONG(pt_regs_buf + ms->pto.rcx);
+	regs->dx = ULONG(pt_regs_buf + ms->pto.rdx);
+	regs->si = ULONG(pt_regs_buf + ms->pto.rsi);
+	regs->di = ULONG(pt_regs_buf + ms->pto.rdi);
+	regs->r8 = ULONG(pt_regs_buf + ms->pto.r8);
+	regs->r9 = ULONG(pt_regs_buf + ms->pto.r9);
+	regs->r10 = ULONG(pt_regs_buf + ms->pto.r10);
+	regs->r11 = ULONG(pt_regs_buf + ms->pto.r11);
+	regs->r12 = ULONG(pt_regs_buf + ms->pto.r12);
+	regs->r13 = ULONG(pt_regs_buf + ms->pto.r13);
+	regs->r14 = ULONG(pt_regs_buf + ms->pto.r14);
+	regs->r15 = ULONG(pt_regs_buf + ms->pto.r15);
+}
+
+/*
+ * Check whether the pt_regs candidate @frame, at @addr on a kernel
+ * stack ending at @stacktop, looks like a frame saved on kernel entry:
+ * the always-set bit 1 of RFLAGS and no bit above ID, and either
+ * kernel selectors with a stack pointer above the frame on the same
+ * stack, or user selectors with the frame at the top of the stack.
+ */
+static int
+gcore_eframe_is_valid(const char *frame, ulong addr, ulong stacktop)
+{
+	struct machine_specific *ms = machdep->machspec;
+	ulong cs = ULONG(frame + ms->pto.cs);
+	ulong ss = ULONG(frame + ms->pto.ss);
+	ulong flags = ULONG(frame + ms->pto.eflags);
+	ulong sp = ULONG(frame + ms->pto.rsp);
+
+	if (!(flags & 0x2) || (flags >> 22))
+		return FALSE;
+
+	if (cs == __KERNEL_CS)
+		return (ss == __KERNEL_DS || ss == 0) &&
+			addr + SIZE(pt_regs) <= sp && sp <= stacktop;
+
+	if (cs == __USER_CS || cs == __USER32_CS)
+		return ss == __USER_DS && addr + SIZE(pt_regs) == stacktop;
+
+	return FALSE;
+}
+
+/*
+ * Find the innermost exception frame on the kernel stack of the
+ * active task @tc without going through back_trace(): the frame is
+ * searched upwards from the stack pointer at which the task was
+ * stopped, as given by machdep->get_stack_frame(), and decoded
+ * directly.
+ *
+ * If the task was stopped on another stack, such as an IRQ or an
+ * exception stack, or no frame is found, FALSE is returned and the
+ * caller falls back to parsing back_trace() output.
+ */
+static int
+gcore_find_regs_in_stack(struct task_context *tc,
+			 struct user_regs_struct *regs)
+{
+	struct bt_info bt;
+	ulong ip, sp, addr;
+	int found = FALSE;
+
+	BZERO(&bt, sizeof(struct bt_info));
+	bt.stackbuf = NULL;
+	bt.tc = tc;
+	bt.task = tc->task;
+	bt.stackbase = GET_STACKBASE(tc->task);
+	bt.stacktop = GET_STACKTOP(tc->task);
+
+	fill_stackbuf(&bt);
+
+	ip = sp = 0;
+	machdep->get_stack_frame(&bt, &ip, &sp);
+
+	if (sp < bt.stackbase || sp >= bt.stacktop)
+		goto out;
+
+	for (addr = roundup(sp, sizeof(ulong));
+	     addr + SIZE(pt_regs) <= bt.stacktop; addr += sizeof(ulong)) {
+		char *frame = bt.stackbuf + (addr - bt.stackbase);
+
+		if (gcore_eframe_is_valid(frame, addr, bt.stacktop)) {
+			gcore_pt_regs_to_user_regs(frame, regs);
+			found = TRUE;
+			break;
+		}
+	}
+
+out:
+	FREEBUF(bt.stackbuf);
+	return found;
+}
+
 static int
 gcore_get_regs_from_eframe(struct task_context *tc,
 			   struct user_regs_struct *regs)
@@ -1588,6 +1776,9 @@ gcore_get_regs_from_eframe(struct task_context *tc,
 	int ret;
 	struct bt_info bt;
 
+	if (gcore_find_regs_in_stack(tc, regs))
+		return TRUE;
+
 	BZERO(&bt, sizeof(struct bt_info));
 	bt.stackbuf = NULL;
 	bt.tc = tc;
@@ -1833,7 +2024,6 @@ static int genregs_get(struct task_context *target,
 	struct user_regs_struct *regs = (struct user_regs_struct *)buf;
 	struct user_regs_struct active_regs;
 	const int active = is_task_active(target->task);
-	struct machine_specific *ms = machdep->machspec;
 
 	BZERO(regs, sizeof(*regs));
 
@@ -1851,31 +2041,11 @@ static int genregs_get(struct task_context *target,
 	 */
 	pt_regs_buf = GETBUF(SIZE(pt_regs));
 
-	readmem(machdep->get_stacktop(target->task) - SIZE(pt_regs), KVADDR,
-		pt_regs_buf, SIZE(pt_regs), "genregs_get: pt_regs",
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, pt_regs_buf, SIZE(pt_regs), "genregs_get: pt_regs",
 		gcore_verbose_error_handle());
 
-	regs->ip = ULONG(pt_regs_buf + ms->pto.rip);
-	regs->sp = ULONG(pt_regs_buf + ms->pto.rsp);
-	regs->cs = ULONG(pt_regs_buf + ms->pto.cs);
-	regs->ss = ULONG(pt_regs_buf + ms->pto.ss);
-	regs->flags = ULONG(pt_regs_buf + ms->pto.eflags);
-	regs->orig_ax = ULONG(pt_regs_buf + ms->pto.orig_rax);
-	regs->bp = ULONG(pt_regs_buf + ms->pto.rbp);
-	regs->ax = ULONG(pt_regs_buf + ms->pto.rax);
-	regs->bx = ULONG(pt_regs_buf + ms->pto.rbx);
-	regs->cx = ULONG(pt_regs_buf + ms->pto.rcx);
-	regs->dx = ULONG(pt_regs_buf + ms->pto.rdx);
-	regs->si = ULONG(pt_regs_buf + ms->pto.rsi);
-	regs->di = ULONG(pt_regs_buf + ms->pto.rdi);
-	regs->r8 = ULONG(pt_regs_buf + ms->pto.r8);
-	regs->r9 = ULONG(pt_regs_buf + ms->pto.r9);
-	regs->r10 = ULONG(pt_regs_buf + ms->pto.r10);
-	regs->r11 = ULONG(pt_regs_buf + ms->pto.r11);
-	regs->r12 = ULONG(pt_regs_buf + ms->pto.r12);
-	regs->r13 = ULONG(pt_regs_buf + ms->pto.r13);
-	regs->r14 = ULONG(pt_regs_buf + ms->pto.r14);
-	regs->r15 = ULONG(pt_regs_buf + ms->pto.r15);
+	gcore_pt_regs_to_user_regs(pt_regs_buf, regs);
 
 	FREEBUF(pt_regs_buf);
 
@@ -1994,6 +2164,8 @@ static void gcore_x86_table_register_get_thread_struct_fpu(void)
 		gxt->get_thread_struct_fpu_size =
 			gcore_x86_get_thread_struct_i387_size;
 	}
+
+	gcore_objcache_set_size(GCORE_OBJ_FPU, sizeof(union thread_xstate));
 }
 
 #ifdef X86_64
@@ -2184,7 +2356,6 @@ static int genregs_get32(struct task_context *target,
 {
 	struct user_regs_struct *regs = (struct user_regs_struct *)buf;
 	char *pt_regs_buf;
-	ulonglong pt_regs_addr;
 
 	if (is_task_active(target->task) && KVMDUMP_DUMPFILE()) {
 		get_regs_from_kvmdump_notes(target, regs);
@@ -2195,17 +2366,9 @@ static int genregs_get32(struct task_context *target,
 
 	pt_regs_buf = GETBUF(SIZE(pt_regs));
 
-	pt_regs_addr = machdep->get_stacktop(target->task) - SIZE(pt_regs);
-
-	/*
-	 * The commit 07b047fc2466249aff7cdb23fa0b0955a7a00d48
-	 * introduced 8-byte offset to match copy_thread().
-	 */
-	if (THIS_KERNEL_VERSION >= LINUX(2,6,16))
-		pt_regs_addr -= 8;
-
-	readmem(pt_regs_addr, KVADDR, pt_regs_buf, SIZE(pt_regs),
-		"genregs_get32: regs", gcore_verbose_error_handle());
+	gcore_objcache_readmem(GCORE_OBJ_PT_REGS, gcore_arch_user_regs(target),
+		0, pt_regs_buf, SIZE(pt_regs), "genregs_get32: regs",
+		gcore_verbose_error_handle());
 
 	BZERO(regs, sizeof(struct user_regs_struct));
 
@@ -2248,9 +2411,10 @@ static int genregs_get32(struct task_context *target,
 	 * saved during __switch_to().
 	 */
 	if (GCORE_VALID_MEMBER(pt_regs_gs) && regs->gs == 0) {
-		readmem(target->task + OFFSET(task_struct_thread) +
-			GCORE_OFFSET(thread_struct_gs), KVADDR, &regs->gs,
-			sizeof(regs->gs), "genregs_get32: regs->gs",
+		gcore_objcache_readmem(GCORE_OBJ_TASK, target->task,
+			OFFSET(task_struct_thread) +
+			GCORE_OFFSET(thread_struct_gs),
+			&regs->gs, sizeof(regs->gs), "genregs_get32: regs->gs",
 			gcore_verbose_error_handle());
 
 		regs->gs &= 0xffff;
@@ -2486,6 +2650,178 @@ int gcore_arch_vsyscall_has_vm_alwaysdump_flag(void)
 	return (vm_flags & VM_ALWAYSDUMP) ? TRUE : FALSE;
 }
 
+#ifdef X86_64
+/*
+ * Page-table walker used by the copy engine in place of uvtop().
+ *
+ * uvtop() walks the tables from the top for each page and re-reads
+ * every table page from the dump. Here, the last table page read at
+ * each level is kept, so walking a VMA costs one PTE-page read per
+ * 512 pages while the upper levels are almost always served from the
+ * cache.
+ *
+ * The walk starts at mm->pgd of the current context. Since the kernel
+ * half of every pgd maps the same tables as init_mm, this also gives
+ * the correct physical address for gate_vma, for which uvtop() needs
+ * its verbose path; see the comment in uvtop_quiet().
+ */
+#define GCORE_PT_LEVELS 4
+#define GCORE_PTRS_PER_TABLE 512
+
+#define GCORE_PAGE_PRESENT  0x001
+#define GCORE_PAGE_PSE      0x080
+#define GCORE_PAGE_PROTNONE 0x100
+
+enum { GCORE_PGD, GCORE_PUD, GCORE_PMD, GCORE_PTE };
+
+static const int gcore_pt_shift[GCORE_PT_LEVELS] = { 39, 30, 21, 12 };
+
+struct gcore_x86_64_pgtable_cache
+{
+	physaddr_t pgd;
+	ulong physical_mask;
+	struct {
+		physaddr_t paddr;
+		int valid;
+		ulong *table;
+	} level[GCORE_PT_LEVELS];
+};
+
+static struct gcore_x86_64_pgtable_cache gcore_x86_64_pgtable_cache;
+static struct gcore_x86_64_pgtable_cache *gpc = &gcore_x86_64_pgtable_cache;
+
+static ulong *gcore_x86_64_read_table(int level, physaddr_t paddr)
+{
+	if (gpc->level[level].valid && gpc->level[level].paddr == paddr)
+		return gpc->level[level].table;
+
+	gpc->level[level].valid = FALSE;
+
+	if (!gcore_readmem(paddr, PHYSADDR, gpc->level[level].table,
+			   PAGE_SIZE, "gcore_x86_64_read_table",
+			   RETURN_ON_ERROR|QUIET))
+		return NULL;
+
+	gpc->level[level].paddr = paddr;
+	gpc->level[level].valid = TRUE;
+
+	return gpc->level[level].table;
+}
+
+/**
+ * Set up the page-table walker for the current context.
+ *
+ * Return TRUE if gcore_arch_vtop() can be used for this session;
+ * otherwise FALSE, in which case the caller falls back to uvtop().
+ */
+int gcore_arch_vtop_init(void)
+{
+	ulong pgd, shift;
+	physaddr_t pgd_paddr;
+	int level;
+
+	BZERO(gpc, sizeof(*gpc));
+
+	if ((machdep->flags & VM_5LEVEL) || XEN())
+		return FALSE;
+
+	pgd = ULONG(fill_mm_struct(task_mm(CURRENT_TASK(), TRUE)) +
+		    OFFSET(mm_struct_pgd));
+
+	if (!pgd || !kvtop(NULL, pgd, &pgd_paddr, FALSE))
+		return FALSE;
+
+	shift = machdep->machspec->physical_mask_shift;
+	if (!shift || shift > 52)
+		shift = 52;
+
+	gpc->pgd = pgd_paddr;
+	gpc->physical_mask = ((1UL << shift) - 1) & ~(PAGE_SIZE - 1);
+
+	for (level = 0; level < GCORE_PT_LEVELS; level++)
+		gpc->level[level].table = (ulong *)GETBUF(PAGE_SIZE);
+
+	return TRUE;
+}
+
+/**
+ * Translate the user virtual address @vaddr of the current context.
+ *
+ * Return TRUE and set *@paddr if the page is present; otherwise
+ * return FALSE. In both cases, *@size is set to the size of the area
+ * mapped by the entry that decided the result: the size of a huge page
+ * for PUD- and PMD-level leaves, the span of the entry for non-present
+ * upper-level entries, and PAGE_SIZE otherwise. All the pages of that
+ * area share the result, and present ones are physically contiguous.
+ */
+int gcore_arch_vtop(ulong vaddr, physaddr_t *paddr, ulong *size)
+{
+	physaddr_t table = gpc->pgd;
+	int level;
+
+	*size = PAGE_SIZE;
+
+	for (level = GCORE_PGD; level < GCORE_PT_LEVELS; level++) {
+		ulong *entries, entry, entry_size;
+
+		if (!(entries = gcore_x86_64_read_table(level, table)))
+			return FALSE;
+
+		entry = entries[(vaddr >> gcore_pt_shift[level])
+				& (GCORE_PTRS_PER_TABLE - 1)];
+		entry_size = 1UL << gcore_pt_shift[level];
+
+		if (level == GCORE_PTE ||
+		    (level != GCORE_PGD && (entry & GCORE_PAGE_PSE))) {
+			/* PROT_NONE mappings keep their frames. */
+			if (!(entry & (GCORE_PAGE_PRESENT|GCORE_PAGE_PROTNONE)))
+				return FALSE;
+			*size = entry_size;
+			*paddr = (entry & gpc->physical_mask & ~(entry_size - 1))
+				+ (vaddr & (entry_size - 1));
+			return TRUE;
+		}
+
+		if (!(entry & GCORE_PAGE_PRESENT)) {
+			*size = entry_size;
+			return FALSE;
+		}
+
+		table = entry & gpc->physical_mask;
+	}
+
+	return FALSE;
+}
+#endif /* X86_64 */
+
+ulong gcore_arch_user_regs(struct task_context *tc)
+{
+	ulong addr = machdep->get_stacktop(tc->task) - SIZE(pt_regs);
+
+#ifdef X86
+	/*
+	 * The commit 07b047fc2466249aff7cdb23fa0b0955a7a00d48
+	 * introduced 8-byte offset to match copy_thread().
+	 */
+	if (THIS_KERNEL_VERSION >= LINUX(2,6,16))
+		addr -= 8;
+#endif
+
+	return addr;
+}
+
+ulong gcore_arch_fpu_area(struct task_context *tc)
+{
+	ulong fpu;
+
+	if (!gxt->get_thread_struct_fpu)
+		return 0;
+
+	fpu = gxt->get_thread_struct_fpu(tc);
+
+	return fpu < tc->task ? fpu : 0;
+}
+
 int gcore_arch_get_fp_valid(struct task_context *tc)
 {
 	const struct user_regset *regset =
@@ -0,0 +1,210 @@
+#! /bin/sh
+#
+# Run gcore against a vmcore in crash batch mode and report its
+# throughput as JSON, one object per line and per run.
+#
+# Usage:
+#
+#   gcore-bench.sh [-e gcore.so] [-j "1 4 8"] [-o "default direct"]
+#                  [-n runs] [-d outdir] vmlinux vmcore pid...|-a
+#
+#   -e  gcore extension to load (../src/gcore.so)
+#   -j  thread counts to run with, one run each (1)
+#   -o  -o option sets to run with, one run each; "default" for none
+#   -n  repetitions of each configuration (3)
+#   -d  directory the cores are written to, emptied before each
+#       run (a new temporary directory)
+#
+# Neither root nor a live kernel is needed, only crash, the vmlinux with
+# debug information and a vmcore of it. To get a vmcore with a known
+# workload, run target-gcore_bench in a virtual machine and, once it
+# prints "ready: PID...", dump the guest with "virsh dump --memory-only"
+# or QEMU's dump-guest-memory, in ELF or in kdump-compressed format.
+#
+# Each result holds the configuration, wall and CPU time, bytes written,
+# MB/s, the size of the core files, the counters printed by "gcore -v 1"
+# and the phase times and call counts printed by "gcore -v 16", summed
+# over the cores:
+#
+#   {"vmcore": "...", "threads": 4, "options": "direct", "run": 1,
+#    "cores": 3, "wall_sec": 2.31, "cpu_sec": 1.92, "bytes": 1073741824,
+#    "mb_per_sec": 443.3, "file_bytes": 1073741824, "pages": ...,
+#    "translations": ...,
+#    "translations_per_page": 0.02, "readmem_calls": ..., ...,
+#    "phases": {"vmas": {"wall": 0.01, "cpu": 0.01}, ...}}
+#
+# "bytes" and "mb_per_sec" count the bytes gcore wrote, as reported by
+# "gcore -v 16", so that they compare across -o option sets: holes are
+# not counted, and compressed cores count their compressed bytes.
+# "file_bytes" is the apparent size of the core files, holes included.
+#
+
+GCORE_SO=$(dirname "$0")/../src/gcore.so
+THREADS=1
+OPTIONS=default
+RUNS=3
+OUTDIR=
+
+usage () {
+    echo "usage: $0 [-e gcore.so] [-j threads] [-o options] [-n runs]" \
+	 "[-d outdir] vmlinux vmcore pid...|-a" >&2
+    exit 2
+}
+
+while getopts e:j:o:n:d: opt; do
+    case $opt in
+	e) GCORE_SO=$OPTARG ;;
+	j) THREADS=$OPTARG ;;
+	o) OPTIONS=$OPTARG ;;
+	n) RUNS=$OPTARG ;;
+	d) OUTDIR=$OPTARG ;;
+	*) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+[ $# -ge 3 ] || usage
+
+VMLINUX=$1
+VMCORE=$2
+shift 2
+TARGETS="$*"
+
+command -v crash > /dev/null || { echo "crash not found" >&2; exit 1; }
+[ -r "$GCORE_SO" ] || { echo "$GCORE_SO not found" >&2; exit 1; }
+GCORE_SO=$(cd "$(dirname "$GCORE_SO")" && pwd)/$(basename "$GCORE_SO")
+
+if [ -z "$OUTDIR" ]; then
+    OUTDIR=$(mktemp -d "${TMPDIR:-/tmp}/gcore-bench.XXXXXX") || exit 1
+    trap 'rm -rf "$OUTDIR"' EXIT
+fi
+mkdir -p "$OUTDIR" || exit 1
+
+now () {
+    date +%s.%N
+}
+
+# User and system time of the children of this shell, in seconds; times
+# must run in this shell, not in a subshell, to account for them.
+child_cpu () {
+    times > "$OUTDIR/times"
+    awk 'NR == 2 {
+	split($1 " " $2, t, /[ ms]+/)
+	print t[1] * 60 + t[2] + t[3] * 60 + t[4]
+    }' "$OUTDIR/times"
+}
+
+# Sum the counters of "gcore -v 1" over all cores of a run.
+parse_log () {
+    awk -v vmcore="$VMCORE" -v threads="$1" -v options="$2" \
+	-v run="$3" -v wall="$4" -v cpu="$5" -v file_bytes="$6" '
+	function num(re,	s) {
+		if (!match($0, re))
+			return 0
+		s = substr($0, RSTART, RLENGTH)
+		gsub(/[^0-9]/, "", s)
+		return s + 0
+	}
+	/Saved / { cores++ }
+	/Copied [0-9]+ pages/ {
+		pages += num("Copied [0-9]+")
+		present += num("[0-9]+ present")
+		faulted += num("[0-9]+ page-faulted")
+	}
+	/translations, / {
+		translations += num("[0-9]+ translations")
+		huge += num("[0-9]+ hitting")
+	}
+	/ reads, .* writes, / {
+		reads += num("[0-9]+ reads")
+		holes += num("[0-9]+ holes")
+	}
+	/zero pages left as holes/ { zero += num("[0-9]+ zero pages") }
+	/excluded from the dump file left/ {
+		excluded += num("[0-9]+ pages excluded")
+	}
+	/Wrote [0-9]+ bytes in / { writes += num("in [0-9]+ writes") }
+	/kernel objects/ {
+		objects += num("Read [0-9]+")
+		fields += num("for [0-9]+ field")
+		saved += num("[0-9]+ readmem")
+	}
+	/maple tree nodes/ { maple += num("Read [0-9]+") }
+	/^{"core": / {
+		bytes += num("\"bytes_written\": [0-9]+")
+		readmem_calls += num("\"readmem_calls\": [0-9]+")
+		uvtop_calls += num("\"uvtop_calls\": [0-9]+")
+		rest = $0
+		while (match(rest, /"[a-z_]+": {"wall": [0-9.]+, "cpu": [0-9.]+}/)) {
+			split(substr(rest, RSTART, RLENGTH), f, /[": {},]+/)
+			if (!(f[2] in wall_of))
+				phases[nr_phases++] = f[2]
+			wall_of[f[2]] += f[4]
+			cpu_of[f[2]] += f[6]
+			rest = substr(rest, RSTART + RLENGTH)
+		}
+	}
+	/page fault at|[Ee]rror/ { errors++ }
+	END {
+		printf "{\"vmcore\": \"%s\", \"threads\": %d, ", vmcore, threads
+		printf "\"options\": \"%s\", \"run\": %d, ", options, run
+		printf "\"cores\": %d, \"wall_sec\": %.3f, ", cores, wall
+		printf "\"cpu_sec\": %.3f, \"bytes\": %.0f, ", cpu, bytes
+		printf "\"mb_per_sec\": %.1f, ", \
+			(wall > 0 ? bytes / 1048576 / wall : 0)
+		printf "\"file_bytes\": %.0f, ", file_bytes
+		printf "\"pages\": %d, \"present\": %d, ", pages, present
+		printf "\"faulted\": %d, \"zero_pages\": %d, ", faulted, zero
+		printf "\"excluded\": %d, ", excluded
+		printf "\"translations\": %d, \"huge\": %d, ", translations, huge
+		printf "\"translations_per_page\": %.4f, ", \
+			(pages ? translations / pages : 0)
+		printf "\"reads\": %d, \"holes\": %d, ", reads, holes
+		printf "\"writes\": %d, \"kernel_objects\": %d, ", writes, objects
+		printf "\"field_reads\": %d, \"readmem_saved\": %d, ", \
+			fields, saved
+		printf "\"readmem_calls\": %d, \"uvtop_calls\": %d, ", \
+			readmem_calls, uvtop_calls
+		printf "\"maple_nodes\": %d, \"messages\": %d, ", maple, errors
+		printf "\"phases\": {"
+		for (i = 0; i < nr_phases; i++)
+			printf "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}", \
+				i ? ", " : "", phases[i], wall_of[phases[i]], \
+				cpu_of[phases[i]]
+		printf "}}\n"
+	}'
+}
+
+for threads in $THREADS; do
+    for options in $OPTIONS; do
+	run=1
+	while [ $run -le "$RUNS" ]; do
+	    rm -f "$OUTDIR"/core.*
+
+	    if [ "$options" = default ]; then
+		oflag=
+	    else
+		oflag="-o $options"
+	    fi
+	    printf 'extend %s\ngcore -v 17 -j %s %s %s\nexit\n' \
+		"$GCORE_SO" "$threads" "$oflag" "$TARGETS" > "$OUTDIR/cmds"
+
+	    child_cpu > "$OUTDIR/cpu0"
+	    t0=$(now)
+	    (cd "$OUTDIR" && crash -s "$VMLINUX" "$VMCORE" -i cmds) \
+		> "$OUTDIR/log" 2>&1 < /dev/null
+	    t1=$(now)
+	    child_cpu > "$OUTDIR/cpu1"
+
+	    cpu=$(cat "$OUTDIR/cpu0" "$OUTDIR/cpu1" |
+		  awk 'NR == 1 { t = $1 } END { print $1 - t }')
+	    file_bytes=$(wc -c "$OUTDIR"/core.* 2> /dev/null |
+			 awk 'END { print $1 + 0 }')
+	    parse_log "$threads" "$options" "$run" \
+		"$(awk "BEGIN { print $t1 - $t0 }")" "$cpu" "$file_bytes" \
+		< "$OUTDIR/log"
+
+	    run=$((run + 1))
+	done
+    done
+done
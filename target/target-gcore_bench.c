@@ -0,0 +1,211 @@
+/*
+ * Workload for gcore benchmarks.
+ *
+ * Forks processes with the given number of threads and anonymous
+ * VMAs each, populated to the given RSS, and waits to be dumped. It
+ * needs no root: huge pages are requested with madvise(MADV_HUGEPAGE)
+ * and only used if transparent huge pages are enabled.
+ *
+ * Usage:
+ *
+ *   target-gcore_bench [-p procs] [-t threads] [-m vmas] [-r rss_mb]
+ *                      [-H huge_mb] [-z zero_pct] [-c compress_pct]
+ *
+ *   -p  processes, including this one (1)
+ *   -t  threads per process, including the main one (1)
+ *   -m  anonymous VMAs per process, besides the huge page one (16)
+ *   -r  RSS per process in MB, spread over the VMAs (64)
+ *   -H  MB per process in a VMA backed by huge pages (0)
+ *   -z  percentage of pages only read, which map the zero page (0)
+ *   -c  percentage of the contents of each written page that is a
+ *       repeated pattern, the rest being random (50)
+ *
+ * Once all processes are set up, it prints their PIDs on one line,
+ * "ready: PID...", and sleeps; take the vmcore then, and kill the
+ * process group when done.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MB (1024UL * 1024UL)
+
+static int nr_threads = 1;
+static int nr_vmas = 16;
+static unsigned long rss_mb = 64;
+static unsigned long huge_mb = 0;
+static int zero_pct = 0;
+static int compress_pct = 50;
+
+static void sleep_to_be_aborted(void)
+{
+	for (;;) sleep(100);
+}
+
+static void *thread_main(void *arg)
+{
+	(void)arg;
+	sleep_to_be_aborted();
+	return NULL;
+}
+
+/*
+ * Fault in the pages of [addr, addr + len): zero_pct of them by reading
+ * only, the others by writing compress_pct of a pattern and random
+ * bytes in the rest.
+ */
+static void populate(char *addr, size_t len, unsigned int seed)
+{
+	size_t pagesize = sysconf(_SC_PAGESIZE);
+	size_t pattern = pagesize * compress_pct / 100;
+	volatile char sink;
+	size_t off, i;
+
+	for (off = 0; off < len; off += pagesize) {
+		char *page = addr + off;
+
+		if ((unsigned int)rand_r(&seed) % 100 < (unsigned int)zero_pct) {
+			sink = page[0];
+			continue;
+		}
+		memset(page, 'G', pattern);
+		for (i = pattern; i < pagesize; i++)
+			page[i] = rand_r(&seed);
+	}
+	(void)sink;
+}
+
+static char *map_anon(size_t len, int prot)
+{
+	char *addr;
+
+	addr = mmap(0, len, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	return addr;
+}
+
+static void setup_process(int id)
+{
+	size_t pagesize = sysconf(_SC_PAGESIZE);
+	size_t per_vma = rss_mb * MB / nr_vmas;
+	pthread_t thread;
+	char *addr;
+	int i;
+
+	per_vma = (per_vma + pagesize - 1) & ~(pagesize - 1);
+	if (!per_vma)
+		per_vma = pagesize;
+
+	for (i = 0; i < nr_vmas; i++) {
+		/*
+		 * A guard page with no access between VMAs keeps the
+		 * kernel from merging them.
+		 */
+		addr = map_anon(per_vma + pagesize, PROT_READ | PROT_WRITE);
+		if (mprotect(addr + per_vma, pagesize, PROT_NONE) < 0) {
+			perror("mprotect");
+			exit(1);
+		}
+		populate(addr, per_vma, id * nr_vmas + i);
+	}
+
+	if (huge_mb) {
+		size_t hugesize = 2 * MB;
+		size_t len = huge_mb * MB;
+
+		addr = map_anon(len + hugesize, PROT_READ | PROT_WRITE);
+		addr = (char *)(((unsigned long)addr + hugesize - 1)
+				& ~(hugesize - 1));
+#ifdef MADV_HUGEPAGE
+		if (madvise(addr, len, MADV_HUGEPAGE) < 0)
+			perror("madvise(MADV_HUGEPAGE)");
+#endif
+		populate(addr, len, ~id);
+	}
+
+	for (i = 1; i < nr_threads; i++) {
+		if (pthread_create(&thread, NULL, thread_main, NULL)) {
+			fputs("pthread_create failed\n", stderr);
+			exit(1);
+		}
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-p procs] [-t threads] [-m vmas] "
+		"[-r rss_mb] [-H huge_mb] [-z zero_pct] [-c compress_pct]\n",
+		name);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int nr_procs = 1;
+	int pipefd[2];
+	pid_t pid;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "p:t:m:r:H:z:c:")) != -1) {
+		switch (c) {
+		case 'p': nr_procs = atoi(optarg); break;
+		case 't': nr_threads = atoi(optarg); break;
+		case 'm': nr_vmas = atoi(optarg); break;
+		case 'r': rss_mb = strtoul(optarg, NULL, 0); break;
+		case 'H': huge_mb = strtoul(optarg, NULL, 0); break;
+		case 'z': zero_pct = atoi(optarg); break;
+		case 'c': compress_pct = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (nr_procs < 1 || nr_threads < 1 || nr_vmas < 1 ||
+	    zero_pct < 0 || zero_pct > 100 ||
+	    compress_pct < 0 || compress_pct > 100)
+		usage(argv[0]);
+
+	if (pipe(pipefd) < 0) {
+		perror("pipe");
+		exit(1);
+	}
+
+	/* Children report their PIDs once set up. */
+	for (i = 1; i < nr_procs; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (pid == 0) {
+			close(pipefd[0]);
+			setup_process(i);
+			pid = getpid();
+			if (write(pipefd[1], &pid, sizeof(pid)) != sizeof(pid))
+				exit(1);
+			close(pipefd[1]);
+			sleep_to_be_aborted();
+		}
+	}
+	close(pipefd[1]);
+
+	setup_process(0);
+
+	printf("ready: %d", getpid());
+	while (read(pipefd[0], &pid, sizeof(pid)) == sizeof(pid))
+		printf(" %d", pid);
+	putchar('\n');
+	fflush(stdout);
+
+	sleep_to_be_aborted();
+	return 0;
+}